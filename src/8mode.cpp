@@ -1,15 +1,49 @@
 #include "8mode.hpp"
+#include "sn76477.h"
 
 
 Plugin *pluginInstance;
 
 
+static void selectChipKernel() {
+	int kernel = sn76477_device::best_kernel();
+
+	// SOFTSN_KERNEL=generic|avx2|avx512 forces a narrower kernel, eg. to compare against older machines
+	const char* forced = getenv("SOFTSN_KERNEL");
+	if (forced) {
+		for (int k = 0; k < sn76477_device::KERNEL_COUNT; k++) {
+			if (!strcmp(forced, sn76477_device::kernel_name(k)) && k <= kernel)
+				kernel = k;
+		}
+	}
+
+	sn76477_device::select_kernel(kernel);
+	INFO("softSN: using %s chip kernel", sn76477_device::kernel_name(sn76477_device::selected_kernel()));
+
+	// SOFTSN_KERNEL_BENCH=1 reports the throughput of every kernel this CPU can run, for both cap models
+	if (getenv("SOFTSN_KERNEL_BENCH")) {
+		static const char* engineNames[] = {"linear", "analog", "fixed"};
+		for (int k = 0; k < sn76477_device::KERNEL_COUNT; k++) {
+			if (!sn76477_device::kernel_supported(k))
+				continue;
+			for (int e = sn76477_device::ENGINE_LINEAR; e <= sn76477_device::ENGINE_FIXED; e++) {
+				double ns = sn76477_device::benchmark_kernel(k, 48000, 480000, e);
+				INFO("softSN: %s kernel, %s caps: %.1f ns/sample (%.0fx realtime at 48 kHz)%s", sn76477_device::kernel_name(k),
+					engineNames[e], ns, ns > 0 ? 1e9 / (ns * 48000) : 0.0, k == sn76477_device::selected_kernel() ? " [selected]" : "");
+			}
+		}
+	}
+}
+
+
 void init(Plugin *p) {
 	pluginInstance = p;
 
 	// Add all Models defined throughout the pluginInstance
 	p->addModel(modelsoftSN);
+	p->addModel(modelsoftSNExp);
 
 	// Any other pluginInstance initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
+	selectChipKernel();
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "rescap.h"
+#include <stdint.h>
+
+// Pins the softSN hard-wires, which the softSN Expander puts under knob and CV
+// control.  Defaults are the parts softSN has always used.
+struct SNExpanderPins {
+	double amp_res = 100;
+	double feedback_res = 100;
+	double slf_cap = CAP_U(.047);
+	double noise_filter_cap = CAP_P(470);
+	double attack_decay_cap = 0.00000005;
+	double one_shot_res = 5000000;
+
+	bool operator==(const SNExpanderPins& p) const {
+		return amp_res == p.amp_res && feedback_res == p.feedback_res && slf_cap == p.slf_cap &&
+			noise_filter_cap == p.noise_filter_cap && attack_decay_cap == p.attack_decay_cap && one_shot_res == p.one_shot_res;
+	}
+	bool operator!=(const SNExpanderPins& p) const {
+		return !(*this == p);
+	}
+};
+
+// Mode switches the expander's gate and CV inputs take over, -1 where the jack
+// is unpatched and softSN's own switch stays in charge
+struct SNExpanderModes {
+	int32_t mixer_a = -1;
+	int32_t mixer_b = -1;
+	int32_t mixer_c = -1;
+	int32_t envelope = -1;
+	int32_t vco_mode = -1;
+
+	bool operator==(const SNExpanderModes& m) const {
+		return mixer_a == m.mixer_a && mixer_b == m.mixer_b && mixer_c == m.mixer_c &&
+			envelope == m.envelope && vco_mode == m.vco_mode;
+	}
+	bool operator!=(const SNExpanderModes& m) const {
+		return !(*this == m);
+	}
+};
+
+// Sent to softSN through its right expander.  The expander only writes and
+// flips a message when a pin, a mode or the preset changed, bumping the serial each
+// time, so softSN only touches the chip when the serial moves.
+struct SNExpanderMessage {
+	uint32_t serial = 0;
+	SNExpanderPins pins;
+	int32_t preset = -1;        // from the PRESET CV, -1 while unpatched
+	SNExpanderModes modes;
+};
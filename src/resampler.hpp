@@ -0,0 +1,98 @@
+#pragma once
+
+#include <math.h>
+
+// Streaming polyphase resampler with a Blackman-windowed sinc kernel.
+//
+// The kernel is tabulated at PHASES fractional offsets and linearly
+// interpolated between them, so any rate ratio works.  Output is pulled one
+// frame at a time; the resampler asks for as many input frames as it needs.
+// Latency is TAPS / 2 input frames.  No allocation happens after construction.
+template <int CHANNELS, int TAPS = 32, int PHASES = 64>
+struct PolyphaseResampler {
+	float kernel[(PHASES + 1) * TAPS];
+	float history[2 * TAPS][CHANNELS];
+	int head = 0;
+	double phase = 1.0;
+	double step = 1.0;
+
+	PolyphaseResampler() {
+		setRates(1.0, 1.0);
+	}
+
+	// Rebuilds the kernel and clears the history
+	void setRates(double inRate, double outRate) {
+		step = inRate / outRate;
+
+		// Cutoff relative to the input Nyquist, lowered when decimating
+		double cutoff = 0.92 * ((outRate < inRate) ? outRate / inRate : 1.0);
+
+		for (int p = 0; p <= PHASES; p++) {
+			float* row = &kernel[p * TAPS];
+			double sum = 0.0;
+
+			for (int k = 0; k < TAPS; k++) {
+				double t = (k - (TAPS / 2 - 1)) - (double) p / PHASES;
+				double x = M_PI * cutoff * t;
+				double sinc = (x == 0.0) ? 1.0 : sin(x) / x;
+				double u = (t + TAPS / 2) / TAPS;
+				double window = (u <= 0.0 || u >= 1.0) ? 0.0 : 0.42 - 0.5 * cos(2 * M_PI * u) + 0.08 * cos(4 * M_PI * u);
+
+				row[k] = cutoff * sinc * window;
+				sum += row[k];
+			}
+
+			// Unity gain at DC for every phase
+			for (int k = 0; k < TAPS; k++)
+				row[k] /= sum;
+		}
+
+		reset();
+	}
+
+	void reset() {
+		for (int i = 0; i < 2 * TAPS; i++) {
+			for (int c = 0; c < CHANNELS; c++)
+				history[i][c] = 0.f;
+		}
+		head = 0;
+		phase = 1.0;
+	}
+
+	void push(const float* frame) {
+		for (int c = 0; c < CHANNELS; c++) {
+			history[head][c] = frame[c];
+			history[head + TAPS][c] = frame[c];
+		}
+		head = (head + 1) % TAPS;
+	}
+
+	// `produce(float* frame)` is called for every input frame that is needed
+	template <class TProducer>
+	void process(TProducer produce, float* out) {
+		while (phase >= 1.0) {
+			float frame[CHANNELS];
+			produce(frame);
+			push(frame);
+			phase -= 1.0;
+		}
+
+		double position = phase * PHASES;
+		int p = (int) position;
+		float frac = (float) (position - p);
+		const float* row0 = &kernel[p * TAPS];
+		const float* row1 = row0 + TAPS;
+		const float(*window)[CHANNELS] = &history[head];
+
+		for (int c = 0; c < CHANNELS; c++)
+			out[c] = 0.f;
+
+		for (int k = 0; k < TAPS; k++) {
+			float h = row0[k] + frac * (row1[k] - row0[k]);
+			for (int c = 0; c < CHANNELS; c++)
+				out[c] += h * window[k][c];
+		}
+
+		phase += step;
+	}
+};
@@ -0,0 +1,133 @@
+#include "rtaudit.hpp"
+
+#ifdef SOFTSN_RT_AUDIT
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+namespace rtaudit {
+
+static thread_local int depth = 0;
+static std::atomic<uint64_t> allocs(0);
+static std::atomic<uint64_t> frees(0);
+static std::atomic<uint64_t> locks(0);
+
+void enter() {
+	depth++;
+}
+
+void leave() {
+	depth--;
+}
+
+Counts counts() {
+	Counts c;
+	c.allocs = allocs.load(std::memory_order_relaxed);
+	c.frees = frees.load(std::memory_order_relaxed);
+	c.locks = locks.load(std::memory_order_relaxed);
+	return c;
+}
+
+void reset() {
+	allocs.store(0, std::memory_order_relaxed);
+	frees.store(0, std::memory_order_relaxed);
+	locks.store(0, std::memory_order_relaxed);
+}
+
+static inline void count(std::atomic<uint64_t>& counter) {
+	if (depth > 0)
+		counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+}
+
+
+#ifdef SOFTSN_RT_AUDIT_WRAP
+
+#include <pthread.h>
+
+// Linked with -Wl,--wrap=<symbol> for each of these, so every call the plugin
+// makes lands here first and is forwarded to the real implementation.
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+int __real_pthread_mutex_lock(pthread_mutex_t* mutex);
+
+void* __wrap_malloc(size_t size) {
+	rtaudit::count(rtaudit::allocs);
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+	rtaudit::count(rtaudit::allocs);
+	return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+	rtaudit::count(rtaudit::allocs);
+	return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr) {
+	if (ptr)
+		rtaudit::count(rtaudit::frees);
+	__real_free(ptr);
+}
+
+int __wrap_pthread_mutex_lock(pthread_mutex_t* mutex) {
+	rtaudit::count(rtaudit::locks);
+	return __real_pthread_mutex_lock(mutex);
+}
+}
+
+// operator new/delete end up in the wrapped malloc()/free() above.
+void* operator new(size_t size) {
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+
+#else
+
+// Without symbol wrapping only the C++ allocator can be intercepted.
+void* operator new(size_t size) {
+	rtaudit::count(rtaudit::allocs);
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+	if (ptr)
+		rtaudit::count(rtaudit::frees);
+	free(ptr);
+}
+
+#endif
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete[](void* ptr) noexcept {
+	operator delete(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+	operator delete(ptr);
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+// Realtime-safety audit, built with `make RT_AUDIT=1`.
+//
+// While a thread is inside an RT_AUDIT_SCOPE(), every heap allocation, free
+// and mutex lock made by the plugin is counted.  The audio path is expected
+// to leave all counters at zero.  In normal builds the scope compiles away.
+
+#ifdef SOFTSN_RT_AUDIT
+
+#include <stdint.h>
+
+namespace rtaudit {
+
+struct Counts {
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t locks;
+
+	uint64_t total() const { return allocs + frees + locks; }
+};
+
+void enter();
+void leave();
+Counts counts();
+void reset();
+
+struct Scope {
+	Scope() { enter(); }
+	~Scope() { leave(); }
+};
+
+}
+
+#define RT_AUDIT_SCOPE() rtaudit::Scope rtAuditScope_
+
+#else
+
+#define RT_AUDIT_SCOPE() do {} while (0)
+
+#endif
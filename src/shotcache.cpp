@@ -0,0 +1,427 @@
+#include "shotcache.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <initializer_list>
+#include <atomic>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#endif
+
+static const char FILE_MAGIC[4] = {'S', 'N', 'O', 'S'};
+static const uint32_t ENTRY_MAGIC = 0x544f4853;     // "SHOT"
+
+// Exclusive advisory lock on `<file>.lock`, held while the file is replaced,
+// appended to, cut or mapped, so instances sharing it take turns.  Only the
+// UI and renderer threads ever wait on it.
+struct FileLock {
+	explicit FileLock(const std::string& file) {
+		std::string lockPath = file + ".lock";
+#ifdef _WIN32
+		handle = CreateFileA(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		OVERLAPPED overlapped = {};
+		if (handle != INVALID_HANDLE_VALUE && !LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+			CloseHandle(handle);
+			handle = INVALID_HANDLE_VALUE;
+		}
+#else
+		fd = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd >= 0 && flock(fd, LOCK_EX)) {
+			close(fd);
+			fd = -1;
+		}
+#endif
+	}
+
+	// Closing the lock file releases the lock
+	~FileLock() {
+#ifdef _WIN32
+		if (handle != INVALID_HANDLE_VALUE)
+			CloseHandle(handle);
+#else
+		if (fd >= 0)
+			close(fd);
+#endif
+	}
+
+	bool held() const {
+#ifdef _WIN32
+		return handle != INVALID_HANDLE_VALUE;
+#else
+		return fd >= 0;
+#endif
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	int fd;
+#endif
+};
+
+// A name next to the file that no other instance, in this process or
+// another, writes to at the same time
+static std::string tempPath(const std::string& file) {
+	static std::atomic<unsigned> serial {0};
+#ifdef _WIN32
+	unsigned long pid = GetCurrentProcessId();
+#else
+	unsigned long pid = getpid();
+#endif
+	return file + "." + std::to_string(pid) + "." + std::to_string(serial++) + ".tmp";
+}
+
+// Cuts the file back to `size` bytes.  Windows refuses while any process has
+// the file mapped, and the tail then waits for a later map().
+static bool cutFile(const std::string& file, uint64_t size) {
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(file.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER end;
+	end.QuadPart = size;
+	bool cut = SetFilePointerEx(handle, end, NULL, FILE_BEGIN) && SetEndOfFile(handle);
+	CloseHandle(handle);
+	return cut;
+#else
+	return !truncate(file.c_str(), size);
+#endif
+}
+
+OneShotCache::~OneShotCache() {
+	stop();
+	unmap(maps[0]);
+	unmap(maps[1]);
+}
+
+bool OneShotCache::start(const std::string& cachePath) {
+	if (running)
+		return true;
+
+	// The first start maps the file; later ones keep that mapping
+	if (path.empty()) {
+		path = cachePath;
+		FileLock lock(path);
+		if (!lock.held()) {
+			path.clear();
+			return false;
+		}
+
+		// A missing file, or one written by another format, starts over
+		FileHeader header;
+		FILE* f = fopen(path.c_str(), "rb");
+		bool valid = f && fread(&header, sizeof(header), 1, f) == 1 && !memcmp(header.magic, FILE_MAGIC, 4) &&
+			header.version == FORMAT_VERSION && header.keySize == sizeof(Key);
+		if (f)
+			fclose(f);
+		// The new file is written aside and renamed over the old one, which
+		// another instance may still have mapped; truncating it in place
+		// would fault their next read through the mapping.
+		if (!valid) {
+			memset(&header, 0, sizeof(header));
+			memcpy(header.magic, FILE_MAGIC, 4);
+			header.version = FORMAT_VERSION;
+			header.keySize = sizeof(Key);
+			std::string temp = tempPath(path);
+			f = fopen(temp.c_str(), "wb");
+			bool written = f && fwrite(&header, sizeof(header), 1, f) == 1;
+			if (f)
+				written = (fclose(f) == 0) && written;
+#ifdef _WIN32
+			// rename() won't replace an existing file on Windows
+			bool renamed = written && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+			bool renamed = written && !rename(temp.c_str(), path.c_str());
+#endif
+			if (!renamed) {
+				remove(temp.c_str());
+				path.clear();
+				return false;
+			}
+		}
+		map(maps[front]);
+	}
+
+	running = true;
+	worker = std::thread([this]() {
+		uint32_t done = 0;
+		std::vector<uint8_t> entry;
+		while (running) {
+			const Request& request = requests.read();
+
+			// Only one mapping can be in flight; the audio thread must pick it up first
+			if (request.serial != done && published.load(std::memory_order_acquire) < 0) {
+				done = request.serial;
+				int current = frontIndex.load(std::memory_order_acquire);
+				Key key = request.key;
+				if (!lookup(maps[current], key, hashKey(key)) && render(key, entry)) {
+					FileLock lock(path);
+					if (lock.held() && append(entry)) {
+						int back = 1 - current;
+						unmap(maps[back]);
+						map(maps[back]);
+						published.store(back, std::memory_order_release);
+					}
+				}
+			}
+			else {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+	});
+	return true;
+}
+
+void OneShotCache::stop() {
+	running = false;
+	if (worker.joinable())
+		worker.join();
+}
+
+// Resistors and caps to 1/1024 of an octave, about 0.07 %
+static double quantizePart(double value) {
+	if (!(value > 0))
+		return value;
+	return exp2(round(log2(value) * 1024) / 1024);
+}
+
+// Voltages to 10 mV, like the VCO wavetable's duty
+static double quantizeVoltage(double value) {
+	return round(value * 100) / 100;
+}
+
+void OneShotCache::makeKey(Key& key, const sn76477_pins& pins, int sampleRate, int engine) {
+	memset(&key, 0, sizeof(key));
+	key.renderVersion = sn76477_device::RENDER_VERSION;
+	key.sampleRate = sampleRate;
+	key.engine = engine;
+	key.pins = pins;
+
+	sn76477_pins& p = key.pins;
+	for (double* part : {&p.one_shot_res, &p.one_shot_cap, &p.slf_res, &p.slf_cap, &p.vco_res, &p.vco_cap, &p.noise_clock_res,
+		&p.noise_filter_res, &p.noise_filter_cap, &p.attack_res, &p.decay_res, &p.attack_decay_cap, &p.amplitude_res, &p.feedback_res})
+		*part = quantizePart(*part);
+	p.vco_voltage = quantizeVoltage(p.vco_voltage);
+	p.pitch_voltage = quantizeVoltage(p.pitch_voltage);
+}
+
+// FNV-1a over the key's bytes
+uint64_t OneShotCache::hashKey(const Key& key) {
+	const uint8_t* p = (const uint8_t*) &key;
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(key); i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+const uint8_t* OneShotCache::lookup(const Mapping& m, const Key& key, uint64_t hash) const {
+	IndexEntry wanted = {hash, 0};
+	for (auto it = std::lower_bound(m.index.begin(), m.index.end(), wanted); it != m.index.end() && it->hash == hash; ++it) {
+		const EntryHeader* entry = (const EntryHeader*) (m.base + it->offset);
+		if (!memcmp(&entry->key, &key, sizeof(key)))
+			return m.base + it->offset;
+	}
+	return nullptr;
+}
+
+bool OneShotCache::find(const Key& key, Hit& hit) {
+	int ready = published.load(std::memory_order_acquire);
+	if (ready >= 0) {
+		front = ready;
+		frontIndex.store(ready, std::memory_order_release);
+		published.store(-1, std::memory_order_release);
+	}
+
+	const uint8_t* entry = lookup(maps[front], key, hashKey(key));
+	if (entry) {
+		hit.offset = entry - maps[front].base;
+		hit.frames = ((const EntryHeader*) entry)->frames;
+		hit.pos = 0;
+		return true;
+	}
+
+	Request& request = requests.write();
+	request.serial = ++requestSerial;
+	request.key = key;
+	requests.publish();
+	return false;
+}
+
+bool OneShotCache::next(Hit& hit, Rsamples& sam) const {
+	if (hit.pos >= hit.frames)
+		return false;
+
+	const float* frame = (const float*) (maps[front].base + hit.offset + sizeof(EntryHeader)) + 2 * hit.pos;
+	sam.s1 = frame[0];
+	sam.s2 = frame[1];
+	hit.pos++;
+	return true;
+}
+
+// Maps the whole file and indexes its entries.  Called with the file
+// locked, so nothing is being written to it: an entry cut short or not an
+// entry is a crash's or a full disk's leftover, and it is cut off with
+// everything after it, or entries appended later could never be reached.
+bool OneShotCache::map(Mapping& m) {
+	for (bool cut = false; ; cut = true) {
+		m.index.clear();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG) sizeof(FileHeader)) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE view = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		void* base = view ? MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (!base) {
+			if (view)
+				CloseHandle(view);
+			CloseHandle(file);
+			return false;
+		}
+		m.file = file;
+		m.view = view;
+		m.base = (const uint8_t*) base;
+		m.size = (size_t) size.QuadPart;
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) || st.st_size < (off_t) sizeof(FileHeader)) {
+			close(fd);
+			return false;
+		}
+		void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED)
+			return false;
+		m.base = (const uint8_t*) base;
+		m.size = st.st_size;
+#endif
+
+		size_t offset = sizeof(FileHeader);
+		while (offset + sizeof(EntryHeader) <= m.size) {
+			const EntryHeader* entry = (const EntryHeader*) (m.base + offset);
+			size_t length = sizeof(EntryHeader) + (size_t) entry->frames * 2 * sizeof(float);
+			if (entry->magic != ENTRY_MAGIC || length > m.size - offset || entry->hash != hashKey(entry->key))
+				break;
+			m.index.push_back({entry->hash, offset});
+			offset += length;
+		}
+		if (offset == m.size || cut)
+			break;
+
+		// Windows can't cut a file while it is mapped, not even by us
+		unmap(m);
+		cutFile(path, offset);
+	}
+	std::sort(m.index.begin(), m.index.end());
+	return true;
+}
+
+void OneShotCache::unmap(Mapping& m) {
+	if (m.base) {
+#ifdef _WIN32
+		UnmapViewOfFile(m.base);
+		CloseHandle(m.view);
+		CloseHandle(m.file);
+#else
+		munmap((void*) m.base, m.size);
+#endif
+	}
+	m = Mapping();
+}
+
+// Plays the one-shot on a reset chip until it falls silent and builds the
+// file entry for it.  One-shots that outlast MAX_SECONDS are left to the chip.
+bool OneShotCache::render(const Key& key, std::vector<uint8_t>& entry) {
+	if (key.pins.envelope_mode != 1 || !key.sampleRate)
+		return false;
+
+	sn76477_device chip;
+	chip.set_m_our_sample_rate(key.sampleRate);
+	chip.device_start();
+	chip.set_pins(key.pins);
+	chip.set_engine(key.engine);
+	chip.set_outputs_connected(1, 1);
+	chip.shot_trigger();
+
+	std::vector<float> frames;
+	int64_t limit = (int64_t) MAX_SECONDS * key.sampleRate;
+	for (int64_t n = 0; !chip.is_silent(); n++) {
+		if (n == limit)
+			return false;
+		Rsamples sam = chip.sound_stream_update(1);
+		frames.push_back((float) sam.s1);
+		frames.push_back((float) sam.s2);
+	}
+
+	EntryHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = ENTRY_MAGIC;
+	header.frames = frames.size() / 2;
+	header.hash = hashKey(key);
+	header.key = key;
+
+	entry.resize(sizeof(header) + frames.size() * sizeof(float));
+	memcpy(&entry[0], &header, sizeof(header));
+	memcpy(&entry[sizeof(header)], frames.data(), frames.size() * sizeof(float));
+	return true;
+}
+
+// Appends an entry in a single write, called with the file locked.  The size
+// limit is checked against the file itself, which other instances grow too.
+// A short write is cut off again rather than left for every later entry to
+// sit behind.
+bool OneShotCache::append(const std::vector<uint8_t>& entry) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart + (int64_t) entry.size() > MAX_FILE_SIZE) {
+		CloseHandle(file);
+		return false;
+	}
+	DWORD written = 0;
+	bool complete = WriteFile(file, entry.data(), (DWORD) entry.size(), &written, NULL) && written == entry.size();
+	CloseHandle(file);
+	int64_t end = size.QuadPart;
+#else
+	int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size + (int64_t) entry.size() > MAX_FILE_SIZE) {
+		close(fd);
+		return false;
+	}
+	ssize_t written = write(fd, entry.data(), entry.size());
+	bool complete = written == (ssize_t) entry.size();
+	complete = (close(fd) == 0) && complete;
+	int64_t end = st.st_size;
+#endif
+	if (!complete && written > 0)
+		cutFile(path, end);
+	return complete;
+}
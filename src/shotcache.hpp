@@ -0,0 +1,125 @@
+#pragma once
+
+#include "sn76477.h"
+#include "triplebuffer.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// On-disk cache of rendered one-shots.
+//
+// A one-shot played from a reset chip only depends on the chip's pins, its
+// clock and the emulation itself, so it can be rendered once and kept.
+// Renders are stored in a single file, content-addressed by a hash of that
+// key, and the file is memory-mapped: a hit plays straight out of the page
+// cache with no render and no copy.
+//
+// The file is an append-only log, a FileHeader followed by entries, each an
+// EntryHeader and `frames` interleaved OUT / VCO cap samples as floats.
+// Instances sharing it replace, append to and map it under an advisory lock
+// on a `.lock` file next to it.  An entry that is cut short or not an entry,
+// which a crash can leave, is cut off the file with whatever follows it.
+//
+// Misses are rendered on a background thread, appended to the file and the
+// file mapped again into the back slot, which is handed to the audio thread
+// through an atomic index like the VCO wavetables.  The audio thread never
+// waits, allocates or touches the file.
+struct OneShotCache {
+	static const uint32_t FORMAT_VERSION = 2;
+	static const int MAX_SECONDS = 30;                      // longer one-shots are not cached
+	static const int64_t MAX_FILE_SIZE = 256 << 20;
+
+	// What a render depends on.  Built with makeKey(), which zeroes the
+	// padding and snaps the pins to a fine grid, so CV that wanders by a
+	// hair still finds the same entry instead of appending a new one.  A hit
+	// and its render both use the snapped pins.
+	struct Key {
+		uint32_t renderVersion;
+		uint32_t sampleRate;
+		uint32_t engine;
+		uint32_t reserved;
+		sn76477_pins pins;
+	};
+
+	// A hit being played, by file offset so it survives a remap
+	struct Hit {
+		uint64_t offset = 0;
+		uint32_t frames = 0;
+		uint32_t pos = 0;
+	};
+
+	~OneShotCache();
+
+	// Maps the file, creating it if needed, and starts the renderer.  The
+	// mapping is kept after stop(), the audio thread may still be reading it.
+	bool start(const std::string& path);
+	void stop();
+
+	static void makeKey(Key& key, const sn76477_pins& pins, int sampleRate, int engine);
+
+	// Audio thread: looks the key up in the newest mapping.  A miss asks the
+	// renderer for it, so the next trigger with the same pins is a hit.
+	bool find(const Key& key, Hit& hit);
+
+	// Audio thread: the next frame of a hit, false once it has ended
+	bool next(Hit& hit, Rsamples& sam) const;
+
+private:
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t keySize;
+		uint32_t reserved;
+	};
+
+	struct EntryHeader {
+		uint32_t magic;
+		uint32_t frames;
+		uint64_t hash;
+		Key key;
+	};
+
+	struct IndexEntry {
+		uint64_t hash;
+		uint64_t offset;
+		bool operator<(const IndexEntry& other) const {
+			return hash < other.hash;
+		}
+	};
+
+	struct Mapping {
+		const uint8_t* base = nullptr;
+		size_t size = 0;
+		std::vector<IndexEntry> index;       // sorted by hash
+#ifdef _WIN32
+		void* file = nullptr;
+		void* view = nullptr;
+#endif
+	};
+
+	struct Request {
+		uint32_t serial = 0;
+		Key key;
+	};
+
+	std::string path;
+	Mapping maps[2];
+	int front = 0;
+	std::atomic<int> frontIndex {0};
+	std::atomic<int> published {-1};
+
+	// Misses, from the audio thread to the renderer
+	TripleBuffer<Request> requests;
+	uint32_t requestSerial = 0;
+
+	std::atomic<bool> running {false};
+	std::thread worker;
+
+	static uint64_t hashKey(const Key& key);
+	const uint8_t* lookup(const Mapping& m, const Key& key, uint64_t hash) const;
+	bool map(Mapping& m);
+	static void unmap(Mapping& m);
+	bool render(const Key& key, std::vector<uint8_t>& entry);
+	bool append(const std::vector<uint8_t>& entry);
+};
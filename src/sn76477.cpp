@@ -41,9 +41,20 @@
  *****************************************************************************/
 
 #include "sn76477.h"
+#include "rtaudit.hpp"
 #include <stdio.h>
+#include <string.h>
+#include <chrono>
 #include "math.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#define SN76477_KERNEL_X86 1
+#else
+#define SN76477_KERNEL_X86 0
+#endif
+
+#define SN76477_FORCE_INLINE inline __attribute__((always_inline))
+
 #define CHECK_BOOLEAN      assert((state & 0x01) == state)
 #define CHECK_POSITIVE     assert(data >= 0.0)
 #define CHECK_VOLTAGE      assert((data >= 0.0) && (data <= 5.0))
@@ -84,6 +95,10 @@
 #define AD_CAP_VOLTAGE_MAX          (4.44)      /* the minimum voltage the attack/decay cap can hold (measured) */
 #define AD_CAP_VOLTAGE_RANGE        (AD_CAP_VOLTAGE_MAX - AD_CAP_VOLTAGE_MIN)
 
+#define RC_CHARGE_TARGET_VOLTAGE    (5.0)       /* Vcc, what the caps charge toward in the analog engine */
+#define RC_DISCHARGE_TARGET_VOLTAGE (0)         /* GND, what the caps discharge toward in the analog engine */
+#define RC_SETTLE_VOLTAGE           (1e-9)      /* how far past GND a discharge aims so it lands on it, see rc_step() */
+
 #define OUT_CENTER_LEVEL_VOLTAGE    (2.57)      /* the voltage that gets outputted when the volumne is 0 (measured) */
 #define OUT_HIGH_CLIP_THRESHOLD     (3.51)      /* the maximum voltage that can be put out (measured) */
 #define OUT_LOW_CLIP_THRESHOLD      (0.715)     /* the minimum voltage that can be put out (measured) */
@@ -107,6 +122,8 @@ static constexpr double out_neg_gain[] =
 	-0.76, -0.78, -0.81, -0.84, -0.85                                      /* 4.0 - 4.4V */
 };
 
+static constexpr int OUT_GAIN_MEASURED_SIZE = sizeof(out_pos_gain) / sizeof(out_pos_gain[0]);
+
 
 /*****************************************************************************
  *
@@ -128,6 +145,102 @@ static inline double min(double a, double b)
 	return (a < b) ? a : b;
 }
 
+
+/*****************************************************************************
+ *
+ *  Fixed point.  ENGINE_FIXED holds the cap voltages and steps as Q32
+ *  integers, volts times 2^32.  The doubles they are set up from only go
+ *  through IEEE basic operations, which round the same everywhere as long
+ *  as nothing is contracted into an FMA (see the Makefile), and the libm
+ *  pow() whose last bit differs between platforms is replaced by
+ *  portable_pow().
+ *
+ *****************************************************************************/
+
+#define Q32(v)                  ((int64_t)((v) * 4294967296.0 + 0.5))  /* for constants >= 0 */
+#define FIXED_VOLTAGE_LIMIT     (1024.0)    /* far outside any cap, keeps the sums well inside 64 bits */
+#define FIXED_STEP_MAX          (256.0)     /* past this every cap crosses its range in one step anyway */
+
+static inline int64_t min_q(int64_t a, int64_t b)
+{
+	return (a < b) ? a : b;
+}
+
+
+static inline int64_t max_q(int64_t a, int64_t b)
+{
+	return (a > b) ? a : b;
+}
+
+
+static inline int64_t to_fixed(double voltage)
+{
+	if (!(voltage == voltage))
+		return 0;
+
+	voltage = min(max(voltage, -FIXED_VOLTAGE_LIMIT), FIXED_VOLTAGE_LIMIT);
+	return (int64_t)floor(voltage * 4294967296.0 + 0.5);
+}
+
+
+static inline double from_fixed(int64_t q)
+{
+	return q * (1.0 / 4294967296.0);    /* exact, the voltages need far fewer than 53 bits */
+}
+
+
+static int64_t fixed_step(double step)
+{
+	if (!(step > 0))
+		return 0;
+
+	/* a step too small to show up still moves the cap, like the doubles do */
+	return max_q(to_fixed(min(step, FIXED_STEP_MAX)), 1);
+}
+
+
+/* x^y for x > 0 from frexp/ldexp, an atanh series for the log and a Taylor
+   series for the exponential, so the result is the same on every libm */
+static double portable_pow(double x, double y)
+{
+	static const double LN2 = 0.69314718055994530942;
+	static const double SQRT_HALF = 0.70710678118654752440;
+
+	int e;
+	double m = frexp(x, &e);
+	if (m < SQRT_HALF)
+	{
+		m = m * 2;
+		e = e - 1;
+	}
+
+	/* ln(m) = 2 atanh((m - 1) / (m + 1)), |z| < 0.172 */
+	double z = (m - 1) / (m + 1);
+	double z2 = z * z;
+	double term = z;
+	double ln = 0;
+	for (int n = 1; n < 40; n += 2)
+	{
+		ln = ln + term / n;
+		term = term * z2;
+	}
+	ln = 2 * ln + e * LN2;
+
+	/* e^(k ln2 + r) = 2^k e^r, |r| <= ln2 / 2 */
+	double v = y * ln;
+	double k = floor(v / LN2 + 0.5);
+	double r = v - k * LN2;
+	double exp_r = 1;
+	term = 1;
+	for (int n = 1; n < 24; n++)
+	{
+		term = term * r / n;
+		exp_r = exp_r + term;
+	}
+
+	return ldexp(exp_r, (int)k);
+}
+
 void sn76477_device::device_start()
 {
 
@@ -199,6 +312,178 @@ void sn76477_device::device_start()
     m_noise_gen_count=1;
     intialize_noise();
 
+	m_trigger_substep = -1;
+	m_sections = SECTION_ALL;
+	m_one_shot_skipped = 0;
+	m_slf_skipped = 0;
+	m_dirty = DIRTY_ALL;
+	update_mode_kernel();
+
+}
+
+
+void sn76477_device::get_state(sn76477_state &state) const
+{
+	state.one_shot_cap_voltage = m_one_shot_cap_voltage;
+	state.one_shot_running_ff = m_one_shot_running_ff;
+	state.slf_cap_voltage = m_slf_cap_voltage;
+	state.slf_out_ff = m_slf_out_ff;
+	state.vco_cap_voltage = m_vco_cap_voltage;
+	state.vco_out_ff = m_vco_out_ff;
+	state.vco_alt_pos_edge_ff = m_vco_alt_pos_edge_ff;
+	state.noise_filter_cap_voltage = m_noise_filter_cap_voltage;
+	state.real_noise_bit_ff = m_real_noise_bit_ff;
+	state.filtered_noise_bit_ff = m_filtered_noise_bit_ff;
+	state.noise_gen_count = m_noise_gen_count;
+	state.attack_decay_cap_voltage = m_attack_decay_cap_voltage;
+	state.rng = m_rng;
+	state.trigger_substep = m_trigger_substep;
+	state.sections = m_sections;
+	state.one_shot_skipped = m_one_shot_skipped;
+	state.slf_skipped = m_slf_skipped;
+}
+
+
+void sn76477_device::set_state(const sn76477_state &state)
+{
+	m_one_shot_cap_voltage = state.one_shot_cap_voltage;
+	m_one_shot_running_ff = state.one_shot_running_ff & 1;
+	m_slf_cap_voltage = state.slf_cap_voltage;
+	m_slf_out_ff = state.slf_out_ff & 1;
+	m_vco_cap_voltage = state.vco_cap_voltage;
+	m_vco_out_ff = state.vco_out_ff & 1;
+	m_vco_alt_pos_edge_ff = state.vco_alt_pos_edge_ff & 1;
+	m_noise_filter_cap_voltage = state.noise_filter_cap_voltage;
+	m_real_noise_bit_ff = state.real_noise_bit_ff & 1;
+	m_filtered_noise_bit_ff = state.filtered_noise_bit_ff & 1;
+	m_noise_gen_count = state.noise_gen_count;
+	m_attack_decay_cap_voltage = state.attack_decay_cap_voltage;
+	m_rng = state.rng;
+	m_trigger_substep = (state.trigger_substep < m_sub_steps) ? state.trigger_substep : -1;
+	m_sections = state.sections & SECTION_ALL;
+	m_one_shot_skipped = state.one_shot_skipped;
+	m_slf_skipped = state.slf_skipped;
+	m_dirty |= DIRTY_SECTIONS;
+}
+
+
+void sn76477_device::get_pins(sn76477_pins &pins) const
+{
+	pins.enable = m_enable;
+	pins.envelope_mode = m_envelope_mode;
+	pins.vco_mode = m_vco_mode;
+	pins.mixer_a = m_mixer_a;
+	pins.mixer_b = m_mixer_b;
+	pins.mixer_c = m_mixer_c;
+	pins.one_shot_res = m_one_shot_res;
+	pins.one_shot_cap = m_one_shot_cap;
+	pins.slf_res = m_slf_res;
+	pins.slf_cap = m_slf_cap;
+	pins.vco_voltage = m_vco_voltage;
+	pins.vco_res = m_vco_res;
+	pins.vco_cap = m_vco_cap;
+	pins.pitch_voltage = m_pitch_voltage;
+	pins.noise_clock_res = m_noise_clock_res;
+	pins.noise_filter_res = m_noise_filter_res;
+	pins.noise_filter_cap = m_noise_filter_cap;
+	pins.attack_res = m_attack_res;
+	pins.decay_res = m_decay_res;
+	pins.attack_decay_cap = m_attack_decay_cap;
+	pins.amplitude_res = m_amplitude_res;
+	pins.feedback_res = m_feedback_res;
+}
+
+
+void sn76477_device::set_pins(const sn76477_pins &pins)
+{
+	set_enable(pins.enable);
+	set_envelope(pins.envelope_mode);
+	set_vco_mode(pins.vco_mode);
+	set_mixer_params(pins.mixer_a, pins.mixer_b, pins.mixer_c);
+	set_oneshot_params(pins.one_shot_cap, pins.one_shot_res);
+	set_slf_params(pins.slf_cap, pins.slf_res);
+	set_vco_params(pins.vco_voltage, pins.vco_cap, pins.vco_res);
+	set_pitch_voltage(pins.pitch_voltage);
+	set_noise_params(pins.noise_clock_res, pins.noise_filter_res, pins.noise_filter_cap);
+	set_attack_params(pins.attack_decay_cap, pins.attack_res);
+	set_decay_res(pins.decay_res);
+	set_amp_res(pins.amplitude_res);
+	set_feedback_res(pins.feedback_res);
+}
+
+
+void sn76477_device::get_config(sn76477_config &config)
+{
+	if (m_dirty & DIRTY_STEPS)
+		update_steps();
+	if (m_dirty & DIRTY_OUT_GAIN)
+	{
+		update_out_gain();
+		m_dirty &= ~DIRTY_OUT_GAIN;
+	}
+
+	get_pins(config.pins);
+	config.sample_rate = m_our_sample_rate;
+	config.sub_steps = m_sub_steps;
+	config.engine = m_engine;
+	config.steps = m_steps;
+	config.center_to_peak_voltage_out = m_center_to_peak_voltage_out;
+	memcpy(config.out_pos_voltage, m_out_pos_voltage, sizeof(m_out_pos_voltage));
+	memcpy(config.out_neg_voltage, m_out_neg_voltage, sizeof(m_out_neg_voltage));
+	memcpy(config.out_pos_q, m_out_pos_q, sizeof(m_out_pos_q));
+	memcpy(config.out_neg_q, m_out_neg_q, sizeof(m_out_neg_q));
+}
+
+
+bool sn76477_device::set_config(const sn76477_config &config)
+{
+	if ((config.sample_rate != m_our_sample_rate) || (config.sub_steps != m_sub_steps) || (config.engine != m_engine))
+		return false;
+
+	const sn76477_pins &pins = config.pins;
+
+	if ((pins.envelope_mode != m_envelope_mode) || (pins.vco_mode != m_vco_mode) ||
+		(pins.mixer_a != m_mixer_a) || (pins.mixer_b != m_mixer_b) || (pins.mixer_c != m_mixer_c))
+	{
+		m_dirty |= DIRTY_SECTIONS;
+		trace_mode(TRACE_MODE_MIXER, (pins.mixer_a & 1) | (pins.mixer_b & 1) << 1 | (pins.mixer_c & 1) << 2);
+		trace_mode(TRACE_MODE_ENVELOPE, pins.envelope_mode);
+		trace_mode(TRACE_MODE_VCO, pins.vco_mode);
+	}
+
+	m_enable = pins.enable;
+	m_envelope_mode = pins.envelope_mode;
+	m_vco_mode = pins.vco_mode;
+	m_mixer_a = pins.mixer_a;
+	m_mixer_b = pins.mixer_b;
+	m_mixer_c = pins.mixer_c;
+	update_mode_kernel();
+	m_one_shot_res = pins.one_shot_res;
+	m_one_shot_cap = pins.one_shot_cap;
+	m_slf_res = pins.slf_res;
+	m_slf_cap = pins.slf_cap;
+	m_vco_voltage = pins.vco_voltage;
+	m_vco_res = pins.vco_res;
+	m_vco_cap = pins.vco_cap;
+	m_pitch_voltage = pins.pitch_voltage;
+	m_noise_clock_res = pins.noise_clock_res;
+	m_noise_filter_res = pins.noise_filter_res;
+	m_noise_filter_cap = pins.noise_filter_cap;
+	m_attack_res = pins.attack_res;
+	m_decay_res = pins.decay_res;
+	m_attack_decay_cap = pins.attack_decay_cap;
+	m_amplitude_res = pins.amplitude_res;
+	m_feedback_res = pins.feedback_res;
+
+	m_steps = config.steps;
+	m_center_to_peak_voltage_out = config.center_to_peak_voltage_out;
+	memcpy(m_out_pos_voltage, config.out_pos_voltage, sizeof(m_out_pos_voltage));
+	memcpy(m_out_neg_voltage, config.out_neg_voltage, sizeof(m_out_neg_voltage));
+	memcpy(m_out_pos_q, config.out_pos_q, sizeof(m_out_pos_q));
+	memcpy(m_out_neg_q, config.out_neg_q, sizeof(m_out_neg_q));
+	m_dirty &= ~(DIRTY_STEPS | DIRTY_OUT_GAIN);
+
+	return true;
 }
 
 
@@ -210,7 +495,7 @@ void sn76477_device::device_start()
  *
  *****************************************************************************/
 
-double sn76477_device::compute_one_shot_cap_charging_rate() /* in V/sec */
+double sn76477_device::compute_one_shot_cap_charging_rate(const sn76477_pins &pins) /* in V/sec */
 {
 	/* this formula was derived using the data points below
 
@@ -227,17 +512,17 @@ double sn76477_device::compute_one_shot_cap_charging_rate() /* in V/sec */
 
 	double ret = 0;
 
-	if ((m_one_shot_res > 0) && (m_one_shot_cap > 0))
+	if ((pins.one_shot_res > 0) && (pins.one_shot_cap > 0))
 	{
-		ret = ONE_SHOT_CAP_VOLTAGE_RANGE / (0.8024 * m_one_shot_res * m_one_shot_cap + 0.002079);
+		ret = ONE_SHOT_CAP_VOLTAGE_RANGE / (0.8024 * pins.one_shot_res * pins.one_shot_cap + 0.002079);
 	}
-	else if (m_one_shot_cap > 0)
+	else if (pins.one_shot_cap > 0)
 	{
 		/* if no resistor, there is no current to charge the cap,
 		   effectively making the one-shot time effectively infinite */
 		ret = +1e-30;
 	}
-	else if (m_one_shot_res > 0)
+	else if (pins.one_shot_res > 0)
 	{
 		/* if no cap, the voltage changes extremely fast,
 		   effectively making the one-shot time 0 */
@@ -249,7 +534,7 @@ double sn76477_device::compute_one_shot_cap_charging_rate() /* in V/sec */
 }
 
 
-double sn76477_device::compute_one_shot_cap_discharging_rate() /* in V/sec */
+double sn76477_device::compute_one_shot_cap_discharging_rate(const sn76477_pins &pins) /* in V/sec */
 {
 	/* this formula was derived using the data points below
 
@@ -262,11 +547,11 @@ double sn76477_device::compute_one_shot_cap_discharging_rate() /* in V/sec */
 
 	double ret = 0;
 
-	if ((m_one_shot_res > 0) && (m_one_shot_cap > 0))
+	if ((pins.one_shot_res > 0) && (pins.one_shot_cap > 0))
 	{
-		ret = ONE_SHOT_CAP_VOLTAGE_RANGE / (854.7 * m_one_shot_cap + 0.00001795);
+		ret = ONE_SHOT_CAP_VOLTAGE_RANGE / (854.7 * pins.one_shot_cap + 0.00001795);
 	}
-	else if (m_one_shot_res > 0)
+	else if (pins.one_shot_res > 0)
 	{
 		/* if no cap, the voltage changes extremely fast,
 		   effectively making the one-shot time 0 */
@@ -277,7 +562,7 @@ double sn76477_device::compute_one_shot_cap_discharging_rate() /* in V/sec */
 }
 
 
-double sn76477_device::compute_slf_cap_charging_rate() /* in V/sec */
+double sn76477_device::compute_slf_cap_charging_rate(const sn76477_pins &pins) /* in V/sec */
 {
 	/* this formula was derived using the data points below
 
@@ -291,17 +576,17 @@ double sn76477_device::compute_slf_cap_charging_rate() /* in V/sec */
 	*/
 	double ret = 0;
 
-	if ((m_slf_res > 0) && (m_slf_cap > 0))
+	if ((pins.slf_res > 0) && (pins.slf_cap > 0))
 	{
 
-		ret = 0.64 * 2 * VCO_CAP_VOLTAGE_RANGE / m_slf_res;
+		ret = 0.64 * 2 * VCO_CAP_VOLTAGE_RANGE / pins.slf_res;
 	}
 
 	return ret;
 }
 
 
-double sn76477_device::compute_slf_cap_discharging_rate() /* in V/sec */
+double sn76477_device::compute_slf_cap_discharging_rate(const sn76477_pins &pins) /* in V/sec */
 {
 	/* this formula was derived using the data points below
 
@@ -316,10 +601,10 @@ double sn76477_device::compute_slf_cap_discharging_rate() /* in V/sec */
 	double ret = 0;
 
 
-	if ((m_slf_res > 0))
+	if ((pins.slf_res > 0))
 	{
 
-		ret = 0.64 * 2 * VCO_CAP_VOLTAGE_RANGE / m_slf_res;
+		ret = 0.64 * 2 * VCO_CAP_VOLTAGE_RANGE / pins.slf_res;
 
 	}
 
@@ -327,28 +612,28 @@ double sn76477_device::compute_slf_cap_discharging_rate() /* in V/sec */
 }
 
 
-double sn76477_device::compute_vco_cap_charging_discharging_rate() /* in V/sec */
+double sn76477_device::compute_vco_cap_charging_discharging_rate(const sn76477_pins &pins) /* in V/sec */
 {
 	double ret = 0;
 
 
-	if (m_vco_res > 0)
+	if (pins.vco_res > 0)
 	{
 
-		ret = 0.64 * 2 * VCO_CAP_VOLTAGE_RANGE / m_vco_res;
+		ret = 0.64 * 2 * VCO_CAP_VOLTAGE_RANGE / pins.vco_res;
 	}
 
 	return ret;
 }
 
 
-double sn76477_device::compute_vco_duty_cycle() /* no measure, just a number */
+double sn76477_device::compute_vco_duty_cycle(const sn76477_pins &pins) /* no measure, just a number */
 {
 	double ret = 0.5;   /* 50% */
 
-	if ((m_vco_voltage > 0) && (m_pitch_voltage != VCO_DUTY_CYCLE_50))
+	if ((pins.vco_voltage > 0) && (pins.pitch_voltage != VCO_DUTY_CYCLE_50))
 	{
-		ret = max(0.5 * (m_pitch_voltage / m_vco_voltage), (VCO_MIN_DUTY_CYCLE / 100.0));
+		ret = max(0.5 * (pins.pitch_voltage / pins.vco_voltage), (VCO_MIN_DUTY_CYCLE / 100.0));
 
 		ret = min(ret, 1);
 	}
@@ -357,7 +642,28 @@ double sn76477_device::compute_vco_duty_cycle() /* no measure, just a number */
 }
 
 
-uint32_t sn76477_device::compute_noise_gen_freq() /* in Hz */
+/* for a VCO triangle spanning 'range' volts; the steps are taken per sub-step */
+static double vco_frequency_for_range(double rate, double multiplier, double range)
+{
+	if ((rate <= 0) || (multiplier <= 0))
+		return 0;
+
+	return rate * sn76477_device::SUB_STEPS / (range * (multiplier + 1 / multiplier));
+}
+
+
+double sn76477_device::vco_frequency(const sn76477_pins &pins) /* in Hz */
+{
+	double multiplier = (1 - compute_vco_duty_cycle(pins)) * 2;
+
+	/* in SLF mode this is the frequency at the top of the sweep */
+	double range = (pins.vco_mode ? VCO_CAP_VOLTAGE_MAX : VCO_TO_SLF_VOLTAGE_DIFF) - VCO_CAP_VOLTAGE_MIN;
+
+	return vco_frequency_for_range(compute_vco_cap_charging_discharging_rate(pins), multiplier, range);
+}
+
+
+uint32_t sn76477_device::compute_noise_gen_freq(const sn76477_pins &pins, bool portable) /* in Hz */
 {
 	/* this formula was derived using the data points below
 
@@ -389,17 +695,17 @@ uint32_t sn76477_device::compute_noise_gen_freq() /* in Hz */
 
 	uint32_t ret = 0;
 
-	if ((m_noise_clock_res >= NOISE_MIN_CLOCK_RES) &&
-		(m_noise_clock_res <= NOISE_MAX_CLOCK_RES))
+	if ((pins.noise_clock_res >= NOISE_MIN_CLOCK_RES) &&
+		(pins.noise_clock_res <= NOISE_MAX_CLOCK_RES))
 	{
-		ret = 339100000 * pow(m_noise_clock_res, -0.8849);
+		ret = 339100000 * (portable ? portable_pow(pins.noise_clock_res, -0.8849) : pow(pins.noise_clock_res, -0.8849));
 	}
 
 	return ret;
 }
 
 
-double sn76477_device::compute_noise_filter_cap_charging_rate() /* in V/sec */
+double sn76477_device::compute_noise_filter_cap_charging_rate(const sn76477_pins &pins) /* in V/sec */
 {
 	/* this formula was derived using the data points below
 
@@ -417,17 +723,17 @@ double sn76477_device::compute_noise_filter_cap_charging_rate() /* in V/sec */
 
 	double ret = 0;
 
-	if ((m_noise_filter_res > 0) && (m_noise_filter_cap > 0))
+	if ((pins.noise_filter_res > 0) && (pins.noise_filter_cap > 0))
 	{
-		ret = NOISE_CAP_VOLTAGE_RANGE / (0.1571 * m_noise_filter_res * m_noise_filter_cap + 0.00001430);
+		ret = NOISE_CAP_VOLTAGE_RANGE / (0.1571 * pins.noise_filter_res * pins.noise_filter_cap + 0.00001430);
 	}
-	else if (m_noise_filter_cap > 0)
+	else if (pins.noise_filter_cap > 0)
 	{
 		/* if no resistor, there is no current to charge the cap,
 		   effectively making the filter's output constants */
 		ret = +1e-30;
 	}
-	else if (m_noise_filter_res > 0)
+	else if (pins.noise_filter_res > 0)
 	{
 		/* if no cap, the voltage changes extremely fast,
 		   effectively disabling the filter */
@@ -438,7 +744,7 @@ return ret;
 }
 
 
-double sn76477_device::compute_noise_filter_cap_discharging_rate() /* in V/sec */
+double sn76477_device::compute_noise_filter_cap_discharging_rate(const sn76477_pins &pins) /* in V/sec */
 {
 	/* this formula was derived using the data points below
 
@@ -455,18 +761,18 @@ double sn76477_device::compute_noise_filter_cap_discharging_rate() /* in V/sec *
 
 	double ret = 0;
 
-	if ((m_noise_filter_res > 0) && (m_noise_filter_cap > 0))
+	if ((pins.noise_filter_res > 0) && (pins.noise_filter_cap > 0))
 	{
-		ret = NOISE_CAP_VOLTAGE_RANGE / (0.1331 * m_noise_filter_res * m_noise_filter_cap + 0.00001734);
+		ret = NOISE_CAP_VOLTAGE_RANGE / (0.1331 * pins.noise_filter_res * pins.noise_filter_cap + 0.00001734);
 	}
-	else if (m_noise_filter_cap > 0)
+	else if (pins.noise_filter_cap > 0)
 	{
 		/* if no resistor, there is no current to charge the cap,
 		   effectively making the filter's output constants */
 
 		ret = +1e-30;
 	}
-	else if (m_noise_filter_res > 0)
+	else if (pins.noise_filter_res > 0)
 	{
 		/* if no cap, the voltage changes extremely fast,
 		   effectively disabling the filter */
@@ -478,21 +784,21 @@ double sn76477_device::compute_noise_filter_cap_discharging_rate() /* in V/sec *
 }
 
 
-double sn76477_device::compute_attack_decay_cap_charging_rate()  /* in V/sec */
+double sn76477_device::compute_attack_decay_cap_charging_rate(const sn76477_pins &pins)  /* in V/sec */
 {
 	double ret = 0;
 
-	if ((m_attack_res > 0) && (m_attack_decay_cap > 0))
+	if ((pins.attack_res > 0) && (pins.attack_decay_cap > 0))
 	{
-		ret = AD_CAP_VOLTAGE_RANGE / (m_attack_res * m_attack_decay_cap);
+		ret = AD_CAP_VOLTAGE_RANGE / (pins.attack_res * pins.attack_decay_cap);
 	}
-	else if (m_attack_decay_cap > 0)
+	else if (pins.attack_decay_cap > 0)
 	{
 		/* if no resistor, there is no current to charge the cap,
 		   effectively making the attack time infinite */
 		ret = +1e-30;
 	}
-	else if (m_attack_res > 0)
+	else if (pins.attack_res > 0)
 	{
 		/* if no cap, the voltage changes extremely fast,
 		   effectively making the attack time 0 */
@@ -503,21 +809,21 @@ double sn76477_device::compute_attack_decay_cap_charging_rate()  /* in V/sec */
 }
 
 
-double sn76477_device::compute_attack_decay_cap_discharging_rate()  /* in V/sec */
+double sn76477_device::compute_attack_decay_cap_discharging_rate(const sn76477_pins &pins)  /* in V/sec */
 {
 	double ret = 0;
 
-	if ((m_decay_res > 0) && (m_attack_decay_cap > 0))
+	if ((pins.decay_res > 0) && (pins.attack_decay_cap > 0))
 	{
-		ret = AD_CAP_VOLTAGE_RANGE / (m_decay_res * m_attack_decay_cap);
+		ret = AD_CAP_VOLTAGE_RANGE / (pins.decay_res * pins.attack_decay_cap);
 	}
-	else if (m_attack_decay_cap > 0)
+	else if (pins.attack_decay_cap > 0)
 	{
 		/* if no resistor, there is no current to charge the cap,
 		   effectively making the decay time infinite */
 		ret = +1e-30;
 	}
-	else if (m_attack_res > 0)
+	else if (pins.attack_res > 0)
 	{
 		/* if no cap, the voltage changes extremely fast,
 		   effectively making the decay time 0 */
@@ -528,7 +834,7 @@ double sn76477_device::compute_attack_decay_cap_discharging_rate()  /* in V/sec
 }
 
 
-double sn76477_device::compute_center_to_peak_voltage_out()
+double sn76477_device::compute_center_to_peak_voltage_out(const sn76477_pins &pins)
 {
 	/* this formula was derived using the data points below
 
@@ -546,9 +852,9 @@ double sn76477_device::compute_center_to_peak_voltage_out()
 
 	double ret = 0;
 
-	if (m_amplitude_res > 0)
+	if (pins.amplitude_res > 0)
 	{
-		ret = 3.818 * (m_feedback_res / m_amplitude_res) + 0.03;
+		ret = 3.818 * (pins.feedback_res / pins.amplitude_res) + 0.03;
 	}
 
 	return ret;
@@ -558,257 +864,1111 @@ double sn76477_device::compute_center_to_peak_voltage_out()
 
 /*****************************************************************************
  *
- *  Noise generator
+ *  Logging functions.  The emulation steps every cap SUB_STEPS times per
+ *  sample at the per-sample rate, so the times it produces are SUB_STEPS
+ *  times shorter than the hardware formulas above.
  *
  *****************************************************************************/
 
-void sn76477_device::intialize_noise()
+int sn76477_device::log_enable_line(const sn76477_pins &pins, char *buf, size_t size)
 {
-	m_rng = 0;
+	static const char *const desc[] =
+	{
+		"Enabled", "Inhibited"
+	};
+
+	return snprintf(buf, size, "Enable line (9): %d [%s]", pins.enable & 1, desc[pins.enable & 1]);
 }
 
 
-inline uint32_t sn76477_device::generate_next_real_noise_bit()
+int sn76477_device::log_mixer_mode(const sn76477_pins &pins, char *buf, size_t size)
 {
-	uint32_t out = ((m_rng >> 28) & 1) ^ ((m_rng >> 0) & 1);
-
-		/* if bits 0-4 and 28 are all zero then force the output to 1 */
-	if ((m_rng & 0x1000001f) == 0)
+	static const char *const desc[] =
 	{
-		out = 1;
-	}
+		"Inhibit", "VCO", "SLF", "VCO/SLF",
+		"Noise", "VCO/Noise", "SLF/Noise", "VCO/SLF/Noise"
+	};
+	uint32_t mode = (pins.mixer_a & 1) | (pins.mixer_b & 1) << 1 | (pins.mixer_c & 1) << 2;
 
-	m_rng = (m_rng >> 1) | (out << 30);
+	return snprintf(buf, size, "Mixer mode (25-27): %d [%s]", mode, desc[mode]);
+}
 
-	return out;
+
+int sn76477_device::log_envelope_mode(const sn76477_pins &pins, char *buf, size_t size)
+{
+	static const char *const desc[] =
+	{
+		"VCO", "One-Shot", "Mixer Only", "VCO with Alternating Polarity"
+	};
+
+	return snprintf(buf, size, "Envelope mode (1,28): %d [%s]", pins.envelope_mode & 3, desc[pins.envelope_mode & 3]);
 }
 
 
+int sn76477_device::log_vco_mode(const sn76477_pins &pins, char *buf, size_t size)
+{
+	static const char *const desc[] =
+	{
+		"External (Pin 16)", "Internal (SLF)"
+	};
+
+	return snprintf(buf, size, "VCO mode (22): %d [%s]", pins.vco_mode & 1, desc[pins.vco_mode & 1]);
+}
 
 
-Rsamples sn76477_device::sound_stream_update(int samples)
+int sn76477_device::log_one_shot_time(const sn76477_pins &pins, char *buf, size_t size)
 {
-	double one_shot_cap_charging_step;
-	double one_shot_cap_discharging_step;
-	double slf_cap_charging_step;
-	double slf_cap_discharging_step;
-	double vco_duty_cycle_multiplier;
-	double vco_cap_charging_step;
-	double vco_cap_discharging_step;
-	double vco_cap_voltage_max;
-	uint32_t noise_gen_freq;
-	double noise_filter_cap_charging_step;
-	double noise_filter_cap_discharging_step;
-	double attack_decay_cap_charging_step;
-	double attack_decay_cap_discharging_step;
-	int    attack_decay_cap_charging;
-	double voltage_out;
-	double center_to_peak_voltage_out;
+	double rate = compute_one_shot_cap_charging_rate(pins);
 
+	if (rate <= 0)
+		return snprintf(buf, size, "One-shot time (23,24): N/A");
+	if (rate <= 1e-30)
+		return snprintf(buf, size, "One-shot time (23,24): Infinite");
 
-	m_mixer_mode= (m_mixer_a & 0b00000001) | (m_mixer_b << 1 & 0b00000010) | (m_mixer_c << 2 & 0b00000100);
+	return snprintf(buf, size, "One-shot time (23,24): %.1f ms", 1000 * ONE_SHOT_CAP_VOLTAGE_RANGE / rate / SUB_STEPS);
+}
 
 
+int sn76477_device::log_slf_freq(const sn76477_pins &pins, char *buf, size_t size)
+{
+	double charging_rate = compute_slf_cap_charging_rate(pins);
+	double discharging_rate = compute_slf_cap_discharging_rate(pins);
 
-	one_shot_cap_charging_step = compute_one_shot_cap_charging_rate() / m_our_sample_rate;
-	one_shot_cap_discharging_step = compute_one_shot_cap_discharging_rate() / m_our_sample_rate;
+	if ((charging_rate <= 0) || (discharging_rate <= 0))
+		return snprintf(buf, size, "SLF frequency (20,21): N/A");
 
-	slf_cap_charging_step = compute_slf_cap_charging_rate() / m_our_sample_rate;
-	slf_cap_discharging_step = compute_slf_cap_discharging_rate() / m_our_sample_rate;
+	double period = SLF_CAP_VOLTAGE_RANGE / charging_rate + SLF_CAP_VOLTAGE_RANGE / discharging_rate;
 
-	vco_duty_cycle_multiplier = (1 - compute_vco_duty_cycle()) * 2;
+	return snprintf(buf, size, "SLF frequency (20,21): %.2f Hz", SUB_STEPS / period);
+}
 
-	vco_cap_charging_step =    compute_vco_cap_charging_discharging_rate() / vco_duty_cycle_multiplier / m_our_sample_rate;
-	vco_cap_discharging_step = compute_vco_cap_charging_discharging_rate() * vco_duty_cycle_multiplier / m_our_sample_rate;
 
-	noise_filter_cap_charging_step = compute_noise_filter_cap_charging_rate() / m_our_sample_rate;
-	noise_filter_cap_discharging_step = compute_noise_filter_cap_discharging_rate() / m_our_sample_rate;
-	noise_gen_freq = compute_noise_gen_freq();
+int sn76477_device::log_vco_pitch_voltage(const sn76477_pins &pins, char *buf, size_t size)
+{
+	return snprintf(buf, size, "VCO pitch voltage (19): %.2fV", pins.pitch_voltage);
+}
 
-	attack_decay_cap_charging_step = compute_attack_decay_cap_charging_rate() / m_our_sample_rate;
-	attack_decay_cap_discharging_step = compute_attack_decay_cap_discharging_rate() / m_our_sample_rate;
 
-	center_to_peak_voltage_out = compute_center_to_peak_voltage_out();
+int sn76477_device::log_vco_duty_cycle(const sn76477_pins &pins, char *buf, size_t size)
+{
+	return snprintf(buf, size, "VCO duty cycle (16,19): %.0f%%", 100 * compute_vco_duty_cycle(pins));
+}
 
 
-	/* process 'samples' number of samples */
+int sn76477_device::log_vco_freq(const sn76477_pins &pins, char *buf, size_t size)
+{
+	double rate = compute_vco_cap_charging_discharging_rate(pins);
+	double multiplier = (1 - compute_vco_duty_cycle(pins)) * 2;
 
-	samples=6;
-	while (samples--)
-	{
+	if ((rate <= 0) || (multiplier <= 0))
+		return snprintf(buf, size, "VCO frequency (17,18): N/A");
 
-		/* update the one-shot cap voltage */
-		if (!m_one_shot_cap_voltage_ext)
-		{
-			if (m_one_shot_running_ff)
-			{
-				/* charging */
-				m_one_shot_cap_voltage = min(m_one_shot_cap_voltage + one_shot_cap_charging_step, ONE_SHOT_CAP_VOLTAGE_MAX);
-			}
-			else
-			{
-				/* discharging */
-				m_one_shot_cap_voltage = max(m_one_shot_cap_voltage - one_shot_cap_discharging_step, ONE_SHOT_CAP_VOLTAGE_MIN);
-			}
-		}
+	if (!pins.vco_mode)
+		return snprintf(buf, size, "VCO frequency (17,18): %.1f Hz",
+			vco_frequency_for_range(rate, multiplier, VCO_TO_SLF_VOLTAGE_DIFF - VCO_CAP_VOLTAGE_MIN));
 
-		if (m_one_shot_cap_voltage >= ONE_SHOT_CAP_VOLTAGE_MAX)
-		{
-			m_one_shot_running_ff = 0;
-		}
+	/* the SLF moves the top of the triangle, and with it the frequency */
+	return snprintf(buf, size, "VCO frequency (17,18): %.1f Hz - %.1f Hz",
+		vco_frequency_for_range(rate, multiplier, VCO_CAP_VOLTAGE_MAX - VCO_CAP_VOLTAGE_MIN),
+		vco_frequency_for_range(rate, multiplier, SLF_CAP_VOLTAGE_MIN + VCO_TO_SLF_VOLTAGE_DIFF - VCO_CAP_VOLTAGE_MIN));
+}
 
 
-		/* update the SLF (super low frequency oscillator) */
-		if (!m_slf_cap_voltage_ext)
-		{
-			/* internal */
-			if (!m_slf_out_ff)
-			{
-				/* charging */
-				m_slf_cap_voltage = min(m_slf_cap_voltage + slf_cap_charging_step, SLF_CAP_VOLTAGE_MAX);
-			}
-			else
-			{
-				/* discharging */
-				m_slf_cap_voltage = max(m_slf_cap_voltage - slf_cap_discharging_step, SLF_CAP_VOLTAGE_MIN);
-			}
-		}
+int sn76477_device::log_vco_ext_voltage(const sn76477_pins &pins, char *buf, size_t size)
+{
+	if (pins.vco_voltage > VCO_MAX_EXT_VOLTAGE)
+		return snprintf(buf, size, "VCO ext. voltage (16): %.2fV (saturated, no output)", pins.vco_voltage);
 
-		if (m_slf_cap_voltage >= SLF_CAP_VOLTAGE_MAX)
-		{
-			m_slf_out_ff = 1;
-		}
-		else if (m_slf_cap_voltage <= SLF_CAP_VOLTAGE_MIN)
-		{
-			m_slf_out_ff = 0;
-		}
+	return snprintf(buf, size, "VCO ext. voltage (16): %.2fV", pins.vco_voltage);
+}
 
 
-		/* update the VCO (voltage controlled oscillator) */
-		if (m_vco_mode)
-		{
-			/* VCO is controlled by SLF */
-			vco_cap_voltage_max =  m_slf_cap_voltage + VCO_TO_SLF_VOLTAGE_DIFF;
-		}
-		else
-		{
-			/* VCO is controlled by external voltage */
+int sn76477_device::log_noise_gen_freq(const sn76477_pins &pins, char *buf, size_t size)
+{
+	uint32_t freq = compute_noise_gen_freq(pins);
 
-			vco_cap_voltage_max =  VCO_TO_SLF_VOLTAGE_DIFF;
-		}
+	if (freq == 0)
+		return snprintf(buf, size, "Noise gen frequency (4): N/A");
 
-		if (!m_vco_cap_voltage_ext)
-		{
-			if (!m_vco_out_ff)
-			{
-				/* charging */
-				m_vco_cap_voltage = min(m_vco_cap_voltage + vco_cap_charging_step, vco_cap_voltage_max);
+	return snprintf(buf, size, "Noise gen frequency (4): %u Hz", freq * SUB_STEPS);
+}
 
-			}
-			else
-			{
-				/* discharging */
-				m_vco_cap_voltage = max(m_vco_cap_voltage - vco_cap_discharging_step, VCO_CAP_VOLTAGE_MIN);
 
-			}
-		}
+int sn76477_device::log_noise_filter_freq(const sn76477_pins &pins, char *buf, size_t size)
+{
+	double charging_rate = compute_noise_filter_cap_charging_rate(pins);
+	double discharging_rate = compute_noise_filter_cap_discharging_rate(pins);
 
-		if (m_vco_cap_voltage >= vco_cap_voltage_max)
-		{
+	if ((charging_rate <= 0) || (discharging_rate <= 0))
+		return snprintf(buf, size, "Noise filter frequency (5,6): N/A");
+	if (charging_rate >= 1000000.0)
+		return snprintf(buf, size, "Noise filter frequency (5,6): Very Large (Filtering Disabled)");
 
-			if (!m_vco_out_ff)
-			{
-				/* positive edge */
-				m_vco_alt_pos_edge_ff = !m_vco_alt_pos_edge_ff;
+	double charging_time = (NOISE_CAP_HIGH_THRESHOLD - NOISE_CAP_LOW_THRESHOLD) / charging_rate;
+	double discharging_time = (NOISE_CAP_HIGH_THRESHOLD - NOISE_CAP_LOW_THRESHOLD) / discharging_rate;
 
+	return snprintf(buf, size, "Noise filter frequency (5,6): %.0f Hz", SUB_STEPS / (charging_time + discharging_time));
+}
 
 
-			}
+/* attack and decay run the whole a/d cap range */
+static int log_ad_time(const char *name, double rate, char *buf, size_t size)
+{
+	if (rate <= 0)
+		return snprintf(buf, size, "%s: N/A", name);
+	if (rate <= 1e-30)
+		return snprintf(buf, size, "%s: Infinite", name);
 
-			m_vco_out_ff = 1;
-		}
-		else if (m_vco_cap_voltage <= VCO_CAP_VOLTAGE_MIN)
-		{
-			m_vco_out_ff = 0;
+	return snprintf(buf, size, "%s: %.1f ms", name, 1000 * AD_CAP_VOLTAGE_RANGE / rate / sn76477_device::SUB_STEPS);
+}
 
 
-		}
+int sn76477_device::log_attack_time(const sn76477_pins &pins, char *buf, size_t size)
+{
+	return log_ad_time("Attack time (8,10)", compute_attack_decay_cap_charging_rate(pins), buf, size);
+}
 
 
-		/* update the noise generator */
-		while (!m_noise_clock_ext && (m_noise_gen_count <= noise_gen_freq))
-		{
-			m_noise_gen_count = m_noise_gen_count + m_our_sample_rate;
+int sn76477_device::log_decay_time(const sn76477_pins &pins, char *buf, size_t size)
+{
+	return log_ad_time("Decay time (7,8)", compute_attack_decay_cap_discharging_rate(pins), buf, size);
+}
 
-			m_real_noise_bit_ff = generate_next_real_noise_bit();
-		}
 
+int sn76477_device::log_voltage_out(const sn76477_pins &pins, char *buf, size_t size)
+{
+	double center_to_peak = compute_center_to_peak_voltage_out(pins);
+	double min_out = OUT_CENTER_LEVEL_VOLTAGE + center_to_peak * out_neg_gain[(int)(AD_CAP_VOLTAGE_MAX * 10)];
+	double max_out = OUT_CENTER_LEVEL_VOLTAGE + center_to_peak * out_pos_gain[(int)(AD_CAP_VOLTAGE_MAX * 10)];
+
+	return snprintf(buf, size, "Voltage OUT range (11,12): %.2fV - %.2fV (clips above %.2fV)", min_out, max_out, OUT_HIGH_CLIP_THRESHOLD);
+}
 
 
-		m_noise_gen_count = m_noise_gen_count - noise_gen_freq;
-		if(m_noise_gen_count >=1000000) m_noise_gen_count=noise_gen_freq+m_our_sample_rate+1;
-		m_noise_filter_cap_voltage_ext=0;
+int sn76477_device::log_complete_state(const sn76477_pins &pins, char *buf, size_t size)
+{
+	static int (*const lines[])(const sn76477_pins &, char *, size_t) =
+	{
+		log_enable_line, log_mixer_mode, log_envelope_mode, log_vco_mode, log_one_shot_time,
+		log_slf_freq, log_vco_pitch_voltage, log_vco_duty_cycle, log_vco_freq, log_vco_ext_voltage,
+		log_noise_gen_freq, log_noise_filter_freq, log_attack_time, log_decay_time, log_voltage_out
+	};
+	static const int count = sizeof(lines) / sizeof(lines[0]);
+	size_t total = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		size_t used = (total < size) ? total : size;
+		total += lines[i](pins, buf + used, size - used);
 
-		/* update the noise filter */
-		if (!m_noise_filter_cap_voltage_ext)
+		if (i < count - 1)
 		{
-			/* internal */
-			if (m_real_noise_bit_ff)
-			{
-				/* charging */
-				m_noise_filter_cap_voltage = min(m_noise_filter_cap_voltage + noise_filter_cap_charging_step, NOISE_CAP_VOLTAGE_MAX);
-			}
-			else
+			if (total + 1 < size)
 			{
-				/* discharging */
-				m_noise_filter_cap_voltage = max(m_noise_filter_cap_voltage - noise_filter_cap_discharging_step, NOISE_CAP_VOLTAGE_MIN);
+				buf[total] = '\n';
+				buf[total + 1] = 0;
 			}
+			total++;
 		}
+	}
 
+	return (int)total;
+}
 
-		/* check the thresholds */
-		if (m_noise_filter_cap_voltage >= NOISE_CAP_HIGH_THRESHOLD)
-		{
-			m_filtered_noise_bit_ff = 0;
-		}
-		else if (m_noise_filter_cap_voltage <= NOISE_CAP_LOW_THRESHOLD)
-		{
-			m_filtered_noise_bit_ff = 1;
-		}
-
-
-		/* based on the envelope mode figure out the attack/decay phase we are in */
-		switch (m_envelope_mode)
-		{
-		case 0:     /* VCO */
-			attack_decay_cap_charging = m_vco_out_ff;
-			break;
-
-		case 1:     /* one-shot */
-			attack_decay_cap_charging = m_one_shot_running_ff;
-			break;
 
-		case 2:
-		default:    /* mixer only */
-			attack_decay_cap_charging = 1;  /* never a decay phase */
-			break;
+/*****************************************************************************
+ *
+ *  Per-sample steps, only recomputed for the groups whose pins changed
+ *
+ *****************************************************************************/
 
-		case 3:     /* VCO with alternating polarity */
-			attack_decay_cap_charging = m_vco_out_ff && m_vco_alt_pos_edge_ff;
-			break;
+/* Keeps a step out of the range where the sub-step loop would run on
+   subnormals or infinities.  The floor is far below anything audible, a cap
+   stepped that slowly takes longer than the age of the universe to move,
+   and past the ceiling every cap crosses its whole range in one sub-step
+   anyway.  Zero and negative steps keep their meaning, no current at all. */
+#define STEP_MIN    (1e-30)
+#define STEP_MAX    (1e+30)
 
+static double clamp_step(double step)
+{
+	if (!(step > 0))
+		return 0;
 
-		}
+	return min(max(step, STEP_MIN), STEP_MAX);
+}
 
 
-		/* update a/d cap voltage */
-		if (!m_attack_decay_cap_voltage_ext)
-		{
+/* Turns a linear step that ramps a cap from one voltage to another into a
+   multiply-add.  The analog engine picks the exponential toward 'target'
+   that takes the same number of steps to cover the same range, so the
+   oscillator frequencies and envelope times are unchanged, only the shape
+   of the curve. */
+static void rc_step(sn76477_rc &rc, uint32_t engine, double step, double from, double to, double target)
+{
+	if (step <= 0)
+	{
+		rc.mul = 1;
+		rc.add = 0;
+	}
+	else if (engine != sn76477_device::ENGINE_ANALOG)
+	{
+		rc.mul = 1;
+		rc.add = (to > from) ? step : -step;
+	}
+	else
+	{
+		/* a cap discharging to its own end point never gets there,
+		   fit it to 99% of the way instead */
+		double settle = 0;
+		if (to == target)
+		{
+			to = to + 0.01 * (from - to);
+			settle = (from > target) ? -RC_SETTLE_VOLTAGE : RC_SETTLE_VOLTAGE;
+		}
+
+		double steps = fabs(to - from) / step;
+		double tau = steps / log((target - from) / (target - to));
+
+		/* aiming a hair past the end point lets the cap land on it and stay
+		   there, instead of creeping toward it through the subnormals */
+		rc.mul = exp(-1 / tau);
+		rc.add = (target + settle) * (1 - rc.mul);
+	}
+}
+
+
+void sn76477_device::update_steps()
+{
+	sn76477_pins pins;
+	get_pins(pins);
+
+	/* the caps are stepped m_sub_steps times per sample at sizes tuned for SUB_STEPS */
+	double step_rate = (double) m_our_sample_rate * m_sub_steps / SUB_STEPS;
+
+	if (m_dirty & DIRTY_ONE_SHOT)
+	{
+		m_steps.one_shot_cap_charging_step = clamp_step(compute_one_shot_cap_charging_rate(pins) / step_rate);
+		m_steps.one_shot_cap_discharging_step = clamp_step(compute_one_shot_cap_discharging_rate(pins) / step_rate);
+
+		rc_step(m_steps.one_shot_charge, m_engine, m_steps.one_shot_cap_charging_step,
+			ONE_SHOT_CAP_VOLTAGE_MIN, ONE_SHOT_CAP_VOLTAGE_MAX, RC_CHARGE_TARGET_VOLTAGE);
+		rc_step(m_steps.one_shot_discharge, m_engine, m_steps.one_shot_cap_discharging_step,
+			ONE_SHOT_CAP_VOLTAGE_MAX, ONE_SHOT_CAP_VOLTAGE_MIN, RC_DISCHARGE_TARGET_VOLTAGE);
+	}
+
+	if (m_dirty & DIRTY_SLF)
+	{
+		m_steps.slf_cap_charging_step = clamp_step(compute_slf_cap_charging_rate(pins) / step_rate);
+		m_steps.slf_cap_discharging_step = clamp_step(compute_slf_cap_discharging_rate(pins) / step_rate);
+
+		rc_step(m_steps.slf_charge, m_engine, m_steps.slf_cap_charging_step,
+			SLF_CAP_VOLTAGE_MIN, SLF_CAP_VOLTAGE_MAX, RC_CHARGE_TARGET_VOLTAGE);
+		rc_step(m_steps.slf_discharge, m_engine, m_steps.slf_cap_discharging_step,
+			SLF_CAP_VOLTAGE_MAX, SLF_CAP_VOLTAGE_MIN, RC_DISCHARGE_TARGET_VOLTAGE);
+	}
+
+	if (m_dirty & DIRTY_VCO)
+	{
+		double vco_duty_cycle_multiplier = (1 - compute_vco_duty_cycle(pins)) * 2;
+
+		m_steps.vco_cap_charging_step =    clamp_step(compute_vco_cap_charging_discharging_rate(pins) / vco_duty_cycle_multiplier / step_rate);
+		m_steps.vco_cap_discharging_step = clamp_step(compute_vco_cap_charging_discharging_rate(pins) * vco_duty_cycle_multiplier / step_rate);
+
+		/* the top of the VCO triangle is fixed when driven externally, and swept by the SLF otherwise */
+		double vco_cap_voltage_max = m_vco_mode ? VCO_CAP_VOLTAGE_MAX : VCO_TO_SLF_VOLTAGE_DIFF;
+
+		rc_step(m_steps.vco_charge, m_engine, m_steps.vco_cap_charging_step,
+			VCO_CAP_VOLTAGE_MIN, vco_cap_voltage_max, RC_CHARGE_TARGET_VOLTAGE);
+		rc_step(m_steps.vco_discharge, m_engine, m_steps.vco_cap_discharging_step,
+			vco_cap_voltage_max, VCO_CAP_VOLTAGE_MIN, RC_DISCHARGE_TARGET_VOLTAGE);
+	}
+
+	if (m_dirty & DIRTY_NOISE)
+	{
+		m_steps.noise_filter_cap_charging_step = clamp_step(compute_noise_filter_cap_charging_rate(pins) / step_rate);
+		m_steps.noise_filter_cap_discharging_step = clamp_step(compute_noise_filter_cap_discharging_rate(pins) / step_rate);
+		m_steps.noise_gen_freq = compute_noise_gen_freq(pins, m_engine == ENGINE_FIXED);
+		m_steps.noise_clock_step = (uint32_t)(step_rate + 0.5);
+
+		rc_step(m_steps.noise_filter_charge, m_engine, m_steps.noise_filter_cap_charging_step,
+			NOISE_CAP_LOW_THRESHOLD, NOISE_CAP_HIGH_THRESHOLD, RC_CHARGE_TARGET_VOLTAGE);
+		rc_step(m_steps.noise_filter_discharge, m_engine, m_steps.noise_filter_cap_discharging_step,
+			NOISE_CAP_HIGH_THRESHOLD, NOISE_CAP_LOW_THRESHOLD, RC_DISCHARGE_TARGET_VOLTAGE);
+	}
+
+	if (m_dirty & DIRTY_AD)
+	{
+		m_steps.attack_decay_cap_charging_step = clamp_step(compute_attack_decay_cap_charging_rate(pins) / step_rate);
+		m_steps.attack_decay_cap_discharging_step = clamp_step(compute_attack_decay_cap_discharging_rate(pins) / step_rate);
+
+		rc_step(m_steps.attack_decay_charge, m_engine, m_steps.attack_decay_cap_charging_step,
+			AD_CAP_VOLTAGE_MIN, AD_CAP_VOLTAGE_MAX, RC_CHARGE_TARGET_VOLTAGE);
+		rc_step(m_steps.attack_decay_discharge, m_engine, m_steps.attack_decay_cap_discharging_step,
+			AD_CAP_VOLTAGE_MAX, AD_CAP_VOLTAGE_MIN, RC_DISCHARGE_TARGET_VOLTAGE);
+	}
+
+	m_steps.one_shot_charge_q = fixed_step(m_steps.one_shot_cap_charging_step);
+	m_steps.one_shot_discharge_q = fixed_step(m_steps.one_shot_cap_discharging_step);
+	m_steps.slf_charge_q = fixed_step(m_steps.slf_cap_charging_step);
+	m_steps.slf_discharge_q = fixed_step(m_steps.slf_cap_discharging_step);
+	m_steps.vco_charge_q = fixed_step(m_steps.vco_cap_charging_step);
+	m_steps.vco_discharge_q = fixed_step(m_steps.vco_cap_discharging_step);
+	m_steps.noise_filter_charge_q = fixed_step(m_steps.noise_filter_cap_charging_step);
+	m_steps.noise_filter_discharge_q = fixed_step(m_steps.noise_filter_cap_discharging_step);
+	m_steps.attack_decay_charge_q = fixed_step(m_steps.attack_decay_cap_charging_step);
+	m_steps.attack_decay_discharge_q = fixed_step(m_steps.attack_decay_cap_discharging_step);
+
+	m_dirty &= ~DIRTY_STEPS;
+}
+
+
+
+/*****************************************************************************
+ *
+ *  Output gain.  The measured 0.1V gain points are resampled onto a finer
+ *  grid with a Catmull-Rom spline, premultiplied by the center-to-peak
+ *  voltage and clipped, so the audio path only has to interpolate linearly
+ *  between two neighbouring entries.
+ *
+ *****************************************************************************/
+
+static double measured_out_gain(const double *table, double voltage)
+{
+	double x = voltage * 10;
+	int i = (int)x;
+	double t = x - i;
+
+	if (i >= OUT_GAIN_MEASURED_SIZE - 1)
+		return table[OUT_GAIN_MEASURED_SIZE - 1];
+
+	double p0 = table[(i > 0) ? i - 1 : 0];
+	double p1 = table[i];
+	double p2 = table[i + 1];
+	double p3 = table[(i + 2 < OUT_GAIN_MEASURED_SIZE) ? i + 2 : OUT_GAIN_MEASURED_SIZE - 1];
+
+	return p1 + 0.5 * t * (p2 - p0 + t * (2 * p0 - 5 * p1 + 4 * p2 - p3 + t * (3 * (p1 - p2) + p3 - p0)));
+}
+
+
+void sn76477_device::update_out_gain()
+{
+	sn76477_pins pins;
+	get_pins(pins);
+
+	m_center_to_peak_voltage_out = compute_center_to_peak_voltage_out(pins);
+
+	for (int i = 0; i < OUT_GAIN_TABLE_SIZE; i++)
+	{
+		double voltage = (double)i / OUT_GAIN_STEPS_PER_VOLT;
+
+		m_out_pos_voltage[i] = min(OUT_CENTER_LEVEL_VOLTAGE + m_center_to_peak_voltage_out * measured_out_gain(out_pos_gain, voltage), OUT_HIGH_CLIP_THRESHOLD);
+		m_out_neg_voltage[i] = max(OUT_CENTER_LEVEL_VOLTAGE + m_center_to_peak_voltage_out * measured_out_gain(out_neg_gain, voltage), OUT_LOW_CLIP_THRESHOLD);
+		m_out_pos_q[i] = to_fixed(m_out_pos_voltage[i]);
+		m_out_neg_q[i] = to_fixed(m_out_neg_voltage[i]);
+	}
+}
+
+
+inline double sn76477_device::out_gain_lerp(const double *table, double ad_cap_voltage)
+{
+	double x = max(ad_cap_voltage, 0) * OUT_GAIN_STEPS_PER_VOLT;
+	int i = min((int)x, OUT_GAIN_TABLE_SIZE - 2);
+	double t = min(x - i, 1);
+
+	return table[i] + t * (table[i + 1] - table[i]);
+}
+
+
+int64_t sn76477_device::out_gain_lerp(const int64_t *table, int64_t ad_cap_voltage)
+{
+	int64_t x = max_q(ad_cap_voltage, 0) * OUT_GAIN_STEPS_PER_VOLT;
+	int64_t i = min_q(x >> 32, OUT_GAIN_TABLE_SIZE - 2);
+	int64_t t = min_q(x - (i << 32), Q32(1)) >> 16;     /* Q16, so the product fits */
+
+	return table[i] + (table[i + 1] - table[i]) * t / 65536;
+}
+
+
+void sn76477_device::out_gain_lerp(const double *table, const double *ad_cap_voltage, double *out, int count)
+{
+	/* branch-free so it vectorizes: the index and fraction of every lane are
+	   computed up front, then the gathers and blends are done in one pass */
+	for (int n = 0; n < count; n++)
+	{
+		double x = max(ad_cap_voltage[n], 0) * OUT_GAIN_STEPS_PER_VOLT;
+		int i = min((int)x, OUT_GAIN_TABLE_SIZE - 2);
+		double t = min(x - i, 1);
+
+		out[n] = table[i] + t * (table[i + 1] - table[i]);
+	}
+}
+
+
+
+/*****************************************************************************
+ *
+ *  Dead-section elimination.  Works back from the outputs that are connected
+ *  to the sections that can still influence them.
+ *
+ *****************************************************************************/
+
+uint32_t sn76477_device::compute_live_sections()
+{
+	uint32_t live = 0;
+
+	/* a chip driving another has to keep the section it taps running */
+	if (m_link_out && (m_link_source == LINK_VCO))
+		live |= SECTION_VCO;
+	if (m_link_out && (m_link_source == LINK_SLF))
+		live |= SECTION_SLF;
+
+	if (m_out_connected || (m_link_out && (m_link_source == LINK_OUT)))
+	{
+		/* the a/d cap sets the OUT level even while the mixer inhibits */
+		live |= SECTION_AD;
+
+		if (m_mixer_a) live |= SECTION_VCO;
+		if (m_mixer_b) live |= SECTION_SLF;
+		if (m_mixer_c) live |= SECTION_NOISE;
+
+		switch (m_envelope_mode)
+		{
+		case 0:     /* VCO */
+		case 3:     /* VCO with alternating polarity */
+			live |= SECTION_VCO;
+			break;
+
+		case 1:     /* one-shot */
+			live |= SECTION_ONE_SHOT;
+			break;
+		}
+	}
+
+	if (m_vco_cap_connected)
+	{
+		live |= SECTION_VCO;
+	}
+
+	if ((live & SECTION_VCO) && m_vco_mode)
+	{
+		/* VCO is controlled by SLF */
+		live |= SECTION_SLF;
+	}
+
+	return live;
+}
+
+
+/* how many steps of 'rc' take a cap from one voltage to another: a line
+   for the linear engine, the log of the remaining distance to the
+   exponential's target for the analog one */
+static double rc_steps(const sn76477_rc &rc, double from, double to)
+{
+	if (rc.mul == 1)
+		return (to - from) / rc.add;
+
+	double target = rc.add / (1 - rc.mul);
+	return log((target - to) / (target - from)) / log(rc.mul);
+}
+
+
+/* where a number of steps of 'rc' take a cap, in closed form */
+static double rc_advance(const sn76477_rc &rc, double voltage, double steps)
+{
+	if (rc.mul == 1)
+		return voltage + steps * rc.add;
+
+	double target = rc.add / (1 - rc.mul);
+	return target + (voltage - target) * pow(rc.mul, steps);
+}
+
+
+/* advance a triangle oscillator by a number of steps in closed form */
+static void advance_triangle(double &voltage, uint32_t &out_ff, const sn76477_rc &charge, const sn76477_rc &discharge,
+	double voltage_min, double voltage_max, double steps)
+{
+	if ((charge.mul == 1 && charge.add == 0) || (discharge.mul == 1 && discharge.add == 0))
+		return;
+
+	double charging_steps = rc_steps(charge, voltage_min, voltage_max);
+	double discharging_steps = rc_steps(discharge, voltage_max, voltage_min);
+	double phase = out_ff ? charging_steps + rc_steps(discharge, voltage_max, voltage)
+	                      : rc_steps(charge, voltage_min, voltage);
+
+	phase = fmod(phase + steps, charging_steps + discharging_steps);
+
+	/* a cap that strayed off its ramp keeps its voltage */
+	if (!(phase >= 0))
+		return;
+
+	if (phase < charging_steps)
+	{
+		voltage = rc_advance(charge, voltage_min, phase);
+		out_ff = 0;
+	}
+	else
+	{
+		voltage = rc_advance(discharge, voltage_max, phase - charging_steps);
+		out_ff = 1;
+	}
+}
+
+
+
+/*****************************************************************************
+ *
+ *  Noise generator
+ *
+ *****************************************************************************/
+
+void sn76477_device::intialize_noise()
+{
+	m_rng = 0;
+}
+
+
+inline uint32_t sn76477_device::generate_next_real_noise_bit()
+{
+	uint32_t out = ((m_rng >> 28) & 1) ^ ((m_rng >> 0) & 1);
+
+		/* if bits 0-4 and 28 are all zero then force the output to 1 */
+	if ((m_rng & 0x1000001f) == 0)
+	{
+		out = 1;
+	}
+
+	m_rng = (m_rng >> 1) | (out << 30);
+
+	return out;
+}
+
+
+
+
+/*****************************************************************************
+ *
+ *  Chip kernel.  render() is force-inlined into one wrapper per ISA level
+ *  below, so the compiler emits a separate copy of it for each target.
+ *
+ *****************************************************************************/
+
+#ifdef SOFTSN_TRACE
+
+/*****************************************************************************
+ *
+ *  Event trace.  Compares the flip-flops with the previous sub-step and
+ *  records whatever changed.
+ *
+ *****************************************************************************/
+
+enum
+{
+	TRACE_VCO_FF      = 1 << 0,
+	TRACE_SLF_FF      = 1 << 1,
+	TRACE_NOISE_FF    = 1 << 2,
+	TRACE_ONE_SHOT_FF = 1 << 3,
+	TRACE_AD_CHARGING = 1 << 4
+};
+
+void sn76477_device::trace_substep(int substep, uint32_t attack_decay_cap_charging)
+{
+	uint32_t state = (m_vco_out_ff ? TRACE_VCO_FF : 0) |
+		(m_slf_out_ff ? TRACE_SLF_FF : 0) |
+		(m_filtered_noise_bit_ff ? TRACE_NOISE_FF : 0) |
+		(m_one_shot_running_ff ? TRACE_ONE_SHOT_FF : 0) |
+		(attack_decay_cap_charging ? TRACE_AD_CHARGING : 0);
+	uint32_t changed = state ^ m_trace_state;
+
+	if (changed & TRACE_VCO_FF)
+		m_trace->record(m_trace_sample, substep, sntrace::VCO_FF, 0, m_vco_out_ff);
+	if (changed & TRACE_SLF_FF)
+		m_trace->record(m_trace_sample, substep, sntrace::SLF_FF, 0, m_slf_out_ff);
+	if (changed & TRACE_NOISE_FF)
+		m_trace->record(m_trace_sample, substep, sntrace::NOISE_FF, 0, m_filtered_noise_bit_ff);
+	if (m_trace_triggered)
+		m_trace->record(m_trace_sample, substep, sntrace::ONE_SHOT_START, 0, m_one_shot_cap_voltage);
+	else if ((changed & TRACE_ONE_SHOT_FF) && !m_one_shot_running_ff)
+		m_trace->record(m_trace_sample, substep, sntrace::ONE_SHOT_END, 0, m_one_shot_cap_voltage);
+	if (changed & TRACE_AD_CHARGING)
+		m_trace->record(m_trace_sample, substep, sntrace::AD_PHASE, 0, attack_decay_cap_charging ? 1 : 0);
+
+	m_trace_state = state;
+	m_trace_triggered = false;
+}
+
+#endif
+
+
+/* the mixer and envelope switches, folded away per kernel */
+template <uint32_t MIXER>
+static SN76477_FORCE_INLINE uint32_t mixer_out(uint32_t vco, uint32_t slf, uint32_t noise)
+{
+	switch (MIXER)
+	{
+	case 1:     /* VCO */
+		return vco;
+
+	case 2:     /* SLF */
+		return slf;
+
+	case 3:     /* VCO and SLF */
+		return vco & slf;
+
+	case 4:     /* noise */
+		return noise;
+
+	case 5:     /* VCO and noise */
+		return vco & noise;
+
+	case 6:     /* SLF and noise */
+		return slf & noise;
+
+	case 7:     /* VCO, SLF and noise */
+		return vco & slf & noise;
+
+	case 0:     /* inhibit */
+	default:
+		return 0;
+	}
+}
+
+
+template <uint32_t ENVELOPE>
+static SN76477_FORCE_INLINE int envelope_charging(uint32_t vco, uint32_t one_shot, uint32_t vco_alt_pos_edge)
+{
+	switch (ENVELOPE)
+	{
+	case 0:     /* VCO */
+		return vco;
+
+	case 1:     /* one-shot */
+		return one_shot;
+
+	case 2:
+	default:    /* mixer only */
+		return 1;   /* never a decay phase */
+
+	case 3:     /* VCO with alternating polarity */
+		return vco && vco_alt_pos_edge;
+	}
+}
+
+
+/* one sub-step of the noise generator and its filter, which nothing else
+   in the chip feeds back into */
+SN76477_FORCE_INLINE void sn76477_device::step_noise(uint32_t noise_gen_freq, uint32_t noise_clock_step,
+	const sn76477_rc &noise_filter_charge, const sn76477_rc &noise_filter_discharge)
+{
+	while (!m_noise_clock_ext && (m_noise_gen_count <= noise_gen_freq))
+	{
+		m_noise_gen_count = m_noise_gen_count + noise_clock_step;
+
+		m_real_noise_bit_ff = generate_next_real_noise_bit();
+	}
+
+
+
+	m_noise_gen_count = m_noise_gen_count - noise_gen_freq;
+	if(m_noise_gen_count >=1000000) m_noise_gen_count=noise_gen_freq+noise_clock_step+1;
+	m_noise_filter_cap_voltage_ext=0;
+
+	/* update the noise filter */
+	if (!m_noise_filter_cap_voltage_ext)
+	{
+		/* internal */
+		if (m_real_noise_bit_ff)
+		{
+			/* charging */
+			m_noise_filter_cap_voltage = min(m_noise_filter_cap_voltage * noise_filter_charge.mul + noise_filter_charge.add, NOISE_CAP_VOLTAGE_MAX);
+		}
+		else
+		{
+			/* discharging */
+			m_noise_filter_cap_voltage = max(m_noise_filter_cap_voltage * noise_filter_discharge.mul + noise_filter_discharge.add, NOISE_CAP_VOLTAGE_MIN);
+		}
+	}
+
+
+	/* check the thresholds */
+	if (m_noise_filter_cap_voltage >= NOISE_CAP_HIGH_THRESHOLD)
+	{
+		m_filtered_noise_bit_ff = 0;
+	}
+	else if (m_noise_filter_cap_voltage <= NOISE_CAP_LOW_THRESHOLD)
+	{
+		m_filtered_noise_bit_ff = 1;
+	}
+}
+
+
+/* the OUT voltage for the current flip-flops and a/d cap voltage */
+template <uint32_t MIXER>
+SN76477_FORCE_INLINE double sn76477_device::mix_voltage_out()
+{
+	if (!m_enable && (m_vco_cap_voltage <= VCO_CAP_VOLTAGE_MAX))
+	{
+		/* enabled */
+		uint32_t out = mixer_out<MIXER>(m_vco_out_ff, m_slf_out_ff, m_filtered_noise_bit_ff);
+
+		/* determine the OUT voltage from the attack/delay cap voltage, already clipped */
+		return out_gain_lerp(out ? m_out_pos_voltage : m_out_neg_voltage, m_attack_decay_cap_voltage);
+	}
+
+	/* disabled */
+	return OUT_CENTER_LEVEL_VOLTAGE;
+}
+
+
+/* Steps the one-shot, SLF, VCO and a/d caps through a whole host sample as
+   the four lanes of one vector, for a sample in which none of the one-shot,
+   SLF or VCO flip-flops changes.  The caps then stay on the ramps they
+   started on and only meet each other through the VCO's top, which the
+   check reads back from the SLF lane.  Every lane takes the multiply-add
+   and clamp the sub-step loop would, so the voltages come out bit-identical
+   to it.  Returns false, leaving the chip untouched, if a flip-flop would
+   change somewhere in the sample; the sub-step loop then runs it instead. */
+template <uint32_t ENVELOPE>
+SN76477_FORCE_INLINE bool sn76477_device::render_ramps()
+{
+	enum { ONE_SHOT, SLF, VCO, AD, LANES };
+
+	double voltage[LANES] = { m_one_shot_cap_voltage, m_slf_cap_voltage, m_vco_cap_voltage, m_attack_decay_cap_voltage };
+	double mul[LANES] = { 1, 1, 1, 1 };
+	double add[LANES] = { 0, 0, 0, 0 };
+	double low[LANES] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+	double high[LANES] = { HUGE_VAL, HUGE_VAL, HUGE_VAL, HUGE_VAL };
+
+	/* a lane that is held or asleep keeps its voltage: v * 1 + 0 */
+	if (!m_one_shot_cap_voltage_ext && (m_sections & SECTION_ONE_SHOT))
+	{
+		const sn76477_rc &rc = m_one_shot_running_ff ? m_steps.one_shot_charge : m_steps.one_shot_discharge;
+		mul[ONE_SHOT] = rc.mul;
+		add[ONE_SHOT] = rc.add;
+		if (m_one_shot_running_ff)
+			high[ONE_SHOT] = ONE_SHOT_CAP_VOLTAGE_MAX;
+		else
+			low[ONE_SHOT] = ONE_SHOT_CAP_VOLTAGE_MIN;
+	}
+
+	if (!m_slf_cap_voltage_ext && (m_sections & SECTION_SLF))
+	{
+		const sn76477_rc &rc = m_slf_out_ff ? m_steps.slf_discharge : m_steps.slf_charge;
+		mul[SLF] = rc.mul;
+		add[SLF] = rc.add;
+		if (m_slf_out_ff)
+			low[SLF] = SLF_CAP_VOLTAGE_MIN;
+		else
+			high[SLF] = SLF_CAP_VOLTAGE_MAX;
+	}
+
+	/* a charging VCO that reaches its top toggles, so its clamp never shows */
+	if (!m_vco_cap_voltage_ext && (m_sections & SECTION_VCO))
+	{
+		const sn76477_rc &rc = m_vco_out_ff ? m_steps.vco_discharge : m_steps.vco_charge;
+		mul[VCO] = rc.mul;
+		add[VCO] = rc.add;
+		if (m_vco_out_ff)
+			low[VCO] = VCO_CAP_VOLTAGE_MIN;
+	}
+
+	/* no attack or no decay step jumps straight to the end: both clamps on it */
+	if (!m_attack_decay_cap_voltage_ext && (m_sections & SECTION_AD))
+	{
+		if (envelope_charging<ENVELOPE>(m_vco_out_ff, m_one_shot_running_ff, m_vco_alt_pos_edge_ff))
+		{
+			mul[AD] = m_steps.attack_decay_charge.mul;
+			add[AD] = m_steps.attack_decay_charge.add;
+			high[AD] = AD_CAP_VOLTAGE_MAX;
+			if (!(m_steps.attack_decay_cap_charging_step > 0))
+				low[AD] = AD_CAP_VOLTAGE_MAX;
+		}
+		else
+		{
+			mul[AD] = m_steps.attack_decay_discharge.mul;
+			add[AD] = m_steps.attack_decay_discharge.add;
+			low[AD] = AD_CAP_VOLTAGE_MIN;
+			if (!(m_steps.attack_decay_cap_discharging_step > 0))
+				high[AD] = AD_CAP_VOLTAGE_MIN;
+		}
+	}
+
+	uint32_t toggles = 0;
+	for (int substep = 0; substep < m_sub_steps; substep++)
+	{
+		for (int lane = 0; lane < LANES; lane++)
+			voltage[lane] = max(min(voltage[lane] * mul[lane] + add[lane], high[lane]), low[lane]);
+
+		double vco_cap_voltage_max = m_vco_mode ? voltage[SLF] + VCO_TO_SLF_VOLTAGE_DIFF : VCO_TO_SLF_VOLTAGE_DIFF;
+
+		toggles |= (m_one_shot_running_ff && (voltage[ONE_SHOT] >= ONE_SHOT_CAP_VOLTAGE_MAX)) |
+			(m_slf_out_ff ? (voltage[SLF] <= SLF_CAP_VOLTAGE_MIN) : (voltage[SLF] >= SLF_CAP_VOLTAGE_MAX)) |
+			(m_vco_out_ff ? (voltage[VCO] <= VCO_CAP_VOLTAGE_MIN) : (voltage[VCO] >= vco_cap_voltage_max));
+	}
+
+	if (toggles)
+		return false;
+
+	m_one_shot_cap_voltage = voltage[ONE_SHOT];
+	m_slf_cap_voltage = voltage[SLF];
+	m_vco_cap_voltage = voltage[VCO];
+	m_attack_decay_cap_voltage = voltage[AD];
+	return true;
+}
+
+
+template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+SN76477_FORCE_INLINE Rsamples sn76477_device::render(int samples)
+{
+	double vco_cap_voltage_max;
+	uint32_t noise_gen_freq;
+	double attack_decay_cap_charging_step;
+	double attack_decay_cap_discharging_step;
+	int    attack_decay_cap_charging;
+	double voltage_out = 0;
+
+
+	if (m_dirty & DIRTY_STEPS)
+	{
+		update_steps();
+	}
+
+	noise_gen_freq = m_steps.noise_gen_freq;
+	const uint32_t noise_clock_step = m_steps.noise_clock_step;
+	attack_decay_cap_charging_step = m_steps.attack_decay_cap_charging_step;
+	attack_decay_cap_discharging_step = m_steps.attack_decay_cap_discharging_step;
+
+	const sn76477_rc one_shot_charge = m_steps.one_shot_charge;
+	const sn76477_rc one_shot_discharge = m_steps.one_shot_discharge;
+	const sn76477_rc slf_charge = m_steps.slf_charge;
+	const sn76477_rc slf_discharge = m_steps.slf_discharge;
+	const sn76477_rc vco_charge = m_steps.vco_charge;
+	const sn76477_rc vco_discharge = m_steps.vco_discharge;
+	const sn76477_rc noise_filter_charge = m_steps.noise_filter_charge;
+	const sn76477_rc noise_filter_discharge = m_steps.noise_filter_discharge;
+	const sn76477_rc attack_decay_charge = m_steps.attack_decay_charge;
+	const sn76477_rc attack_decay_discharge = m_steps.attack_decay_discharge;
+
+	if (m_dirty & DIRTY_OUT_GAIN)
+	{
+		update_out_gain();
+		m_dirty &= ~DIRTY_OUT_GAIN;
+	}
+
+	if (m_dirty & DIRTY_SECTIONS)
+	{
+		uint32_t live = compute_live_sections();
+		uint32_t woken = live & ~m_sections;
+
+		/* sections coming back catch up on the time they sat out */
+		if (woken & SECTION_ONE_SHOT)
+		{
+			if (m_one_shot_running_ff)
+				m_one_shot_cap_voltage = min(rc_advance(one_shot_charge, m_one_shot_cap_voltage, m_one_shot_skipped), ONE_SHOT_CAP_VOLTAGE_MAX);
+			else
+				m_one_shot_cap_voltage = max(rc_advance(one_shot_discharge, m_one_shot_cap_voltage, m_one_shot_skipped), ONE_SHOT_CAP_VOLTAGE_MIN);
+			if (m_one_shot_cap_voltage >= ONE_SHOT_CAP_VOLTAGE_MAX)
+				m_one_shot_running_ff = 0;
+		}
+		if ((woken & SECTION_SLF) && !m_slf_cap_voltage_ext)
+		{
+			advance_triangle(m_slf_cap_voltage, m_slf_out_ff, slf_charge, slf_discharge,
+				SLF_CAP_VOLTAGE_MIN, SLF_CAP_VOLTAGE_MAX, m_slf_skipped);
+		}
+		if (woken & SECTION_NOISE)
+		{
+			m_noise_gen_count = 1;
+		}
+
+		m_one_shot_skipped = 0;
+		m_slf_skipped = 0;
+		m_sections = live;
+		m_dirty &= ~DIRTY_SECTIONS;
+	}
+
+	if (!(m_sections & SECTION_ONE_SHOT))
+		m_one_shot_skipped += m_sub_steps;
+	if (!(m_sections & SECTION_SLF))
+		m_slf_skipped += m_sub_steps;
+
+
+	if (FIXED)
+		return render_fixed<MIXER, ENVELOPE>();
+
+
+	/* most samples see no flip-flop change outside the noise filter, and
+	   are rendered by the ramps with the noise stepped on its own */
+	bool traced = false;
+#ifdef SOFTSN_TRACE
+	traced = (m_trace != nullptr);
+#endif
+	bool ramped = (m_trigger_substep < 0) && !m_link_in && !m_link_out && !traced && render_ramps<ENVELOPE>();
+	if (ramped)
+	{
+		if (m_sections & SECTION_NOISE)
+		{
+			for (int i = 0; i < m_sub_steps; i++)
+				step_noise(noise_gen_freq, noise_clock_step, noise_filter_charge, noise_filter_discharge);
+		}
+		voltage_out = mix_voltage_out<MIXER>();
+	}
+
+
+	/* process 'samples' number of samples */
+
+	int substep = 0;
+
+	samples = ramped ? 0 : m_sub_steps;
+	while (samples--)
+	{
+		/* a trigger that arrived between two host samples lands on its own sub-step */
+		if (substep++ == m_trigger_substep)
+		{
+			shot_trigger();
+			m_trigger_substep = -1;
+		}
+
+		/* the chip driving this one already ran this sub-step */
+		double link = 0;
+		if (m_link_in)
+		{
+			link = m_link_in->tap[substep - 1];
+
+			if (m_link_target == LINK_ONE_SHOT)
+			{
+				uint32_t gate = (link > 0.5);
+				if (gate && !m_link_gate)
+					shot_trigger();
+				m_link_gate = gate;
+			}
+			else if (m_link_target == LINK_SLF)
+			{
+				m_slf_cap_voltage = SLF_CAP_VOLTAGE_MIN + link * SLF_CAP_VOLTAGE_RANGE;
+			}
+		}
+
+		/* update the one-shot cap voltage */
+		if (!m_one_shot_cap_voltage_ext && (m_sections & SECTION_ONE_SHOT))
+		{
+			if (m_one_shot_running_ff)
+			{
+				/* charging */
+				m_one_shot_cap_voltage = min(m_one_shot_cap_voltage * one_shot_charge.mul + one_shot_charge.add, ONE_SHOT_CAP_VOLTAGE_MAX);
+			}
+			else
+			{
+				/* discharging */
+				m_one_shot_cap_voltage = max(m_one_shot_cap_voltage * one_shot_discharge.mul + one_shot_discharge.add, ONE_SHOT_CAP_VOLTAGE_MIN);
+			}
+		}
+
+		if (m_one_shot_cap_voltage >= ONE_SHOT_CAP_VOLTAGE_MAX)
+		{
+			m_one_shot_running_ff = 0;
+		}
+
+
+		/* update the SLF (super low frequency oscillator) */
+		if (!m_slf_cap_voltage_ext && (m_sections & SECTION_SLF) && !(m_link_in && (m_link_target == LINK_SLF)))
+		{
+			/* internal */
+			if (!m_slf_out_ff)
+			{
+				/* charging */
+				m_slf_cap_voltage = min(m_slf_cap_voltage * slf_charge.mul + slf_charge.add, SLF_CAP_VOLTAGE_MAX);
+			}
+			else
+			{
+				/* discharging */
+				m_slf_cap_voltage = max(m_slf_cap_voltage * slf_discharge.mul + slf_discharge.add, SLF_CAP_VOLTAGE_MIN);
+			}
+		}
+
+		if (m_slf_cap_voltage >= SLF_CAP_VOLTAGE_MAX)
+		{
+			m_slf_out_ff = 1;
+		}
+		else if (m_slf_cap_voltage <= SLF_CAP_VOLTAGE_MIN)
+		{
+			m_slf_out_ff = 0;
+		}
+
+
+		/* update the VCO (voltage controlled oscillator) */
+		if (m_link_in && (m_link_target == LINK_VCO))
+		{
+			/* VCO is controlled by the driving chip, through the same path as the SLF */
+			vco_cap_voltage_max = SLF_CAP_VOLTAGE_MIN + link * SLF_CAP_VOLTAGE_RANGE + VCO_TO_SLF_VOLTAGE_DIFF;
+		}
+		else if (m_vco_mode)
+		{
+			/* VCO is controlled by SLF */
+			vco_cap_voltage_max =  m_slf_cap_voltage + VCO_TO_SLF_VOLTAGE_DIFF;
+		}
+		else
+		{
+			/* VCO is controlled by external voltage */
+
+			vco_cap_voltage_max =  VCO_TO_SLF_VOLTAGE_DIFF;
+		}
+
+		if (!m_vco_cap_voltage_ext && (m_sections & SECTION_VCO))
+		{
+			if (!m_vco_out_ff)
+			{
+				/* charging */
+				m_vco_cap_voltage = min(m_vco_cap_voltage * vco_charge.mul + vco_charge.add, vco_cap_voltage_max);
+
+			}
+			else
+			{
+				/* discharging */
+				m_vco_cap_voltage = max(m_vco_cap_voltage * vco_discharge.mul + vco_discharge.add, VCO_CAP_VOLTAGE_MIN);
+
+			}
+		}
+
+		if (m_vco_cap_voltage >= vco_cap_voltage_max)
+		{
+
+			if (!m_vco_out_ff)
+			{
+				/* positive edge */
+				m_vco_alt_pos_edge_ff = !m_vco_alt_pos_edge_ff;
+
+
+
+			}
+
+			m_vco_out_ff = 1;
+		}
+		else if (m_vco_cap_voltage <= VCO_CAP_VOLTAGE_MIN)
+		{
+			m_vco_out_ff = 0;
+
+
+		}
+
+
+		/* update the noise generator */
+		if (m_sections & SECTION_NOISE)
+		{
+			step_noise(noise_gen_freq, noise_clock_step, noise_filter_charge, noise_filter_discharge);
+		}
+
+
+		/* based on the envelope mode figure out the attack/decay phase we are in */
+		attack_decay_cap_charging = envelope_charging<ENVELOPE>(m_vco_out_ff, m_one_shot_running_ff, m_vco_alt_pos_edge_ff);
+
+
+		/* update a/d cap voltage */
+		if (!m_attack_decay_cap_voltage_ext && (m_sections & SECTION_AD))
+		{
 			if (attack_decay_cap_charging)
 			{
 				if (attack_decay_cap_charging_step > 0)
 				{
-					m_attack_decay_cap_voltage = min(m_attack_decay_cap_voltage + attack_decay_cap_charging_step, AD_CAP_VOLTAGE_MAX);
+					m_attack_decay_cap_voltage = min(m_attack_decay_cap_voltage * attack_decay_charge.mul + attack_decay_charge.add, AD_CAP_VOLTAGE_MAX);
 				}
 				else
 				{
@@ -821,7 +1981,7 @@ Rsamples sn76477_device::sound_stream_update(int samples)
 				/* discharging */
 				if (attack_decay_cap_discharging_step > 0)
 				{
-					m_attack_decay_cap_voltage = max(m_attack_decay_cap_voltage - attack_decay_cap_discharging_step, AD_CAP_VOLTAGE_MIN);
+					m_attack_decay_cap_voltage = max(m_attack_decay_cap_voltage * attack_decay_discharge.mul + attack_decay_discharge.add, AD_CAP_VOLTAGE_MIN);
 				}
 				else
 				{
@@ -833,94 +1993,566 @@ Rsamples sn76477_device::sound_stream_update(int samples)
 
 
 		/* mix the output, if enabled, or not saturated by the VCO */
+		voltage_out = mix_voltage_out<MIXER>();
+
+
+		/* convert it to a signed 16-bit sample,
+		   -32767 = OUT_LOW_CLIP_THRESHOLD
+		        0 = OUT_CENTER_LEVEL_VOLTAGE
+		    32767 = 2 * OUT_CENTER_LEVEL_VOLTAGE + OUT_LOW_CLIP_THRESHOLD
+
+		              / Vout - Vmin    \
+		    sample = |  ----------- - 1 | * 32767
+		              \ Vcen - Vmin    /
+		 */
 
-		if (!m_enable && (m_vco_cap_voltage <= VCO_CAP_VOLTAGE_MAX))
+		if (m_link_out)
 		{
-			uint32_t out;
+			double tap;
 
-			/* enabled */
-			switch (m_mixer_mode)
+			switch (m_link_source)
 			{
-			case 1:     /* VCO */
-				out = m_vco_out_ff;
+			case LINK_SLF:
+				tap = (m_slf_cap_voltage - SLF_CAP_VOLTAGE_MIN) / SLF_CAP_VOLTAGE_RANGE;
 				break;
 
-			case 2:     /* SLF */
-				out = m_slf_out_ff;
+			case LINK_OUT:
+				tap = (voltage_out - OUT_LOW_CLIP_THRESHOLD) / (2 * (OUT_CENTER_LEVEL_VOLTAGE - OUT_LOW_CLIP_THRESHOLD));
 				break;
 
-			case 4:     /* noise */
-				out = m_filtered_noise_bit_ff;
-
+			default:
+				/* over the triangle's current span, which the SLF or the link may be moving */
+				tap = (m_vco_cap_voltage - VCO_CAP_VOLTAGE_MIN) / (vco_cap_voltage_max - VCO_CAP_VOLTAGE_MIN);
 				break;
+			}
 
-			case 5:     /* VCO and noise */
-				out = m_vco_out_ff & m_filtered_noise_bit_ff;
-				break;
+			m_link_out->tap[substep - 1] = min(max(tap, 0), 1);
+		}
 
-			case 6:     /* SLF and noise */
-				out = m_slf_out_ff & m_filtered_noise_bit_ff;
-				break;
+#ifdef SOFTSN_TRACE
+		if (m_trace)
+			trace_substep(substep - 1, attack_decay_cap_charging);
+#endif
+	}
 
-			case 7:     /* VCO, SLF and noise */
-				out = m_vco_out_ff & m_slf_out_ff & m_filtered_noise_bit_ff;
-				break;
+#ifdef SOFTSN_TRACE
+	m_trace_sample++;
+#endif
 
-			case 3:     /* VCO and SLF */
-				out = m_vco_out_ff & m_slf_out_ff;
-				break;
+	double sample=(((voltage_out - OUT_LOW_CLIP_THRESHOLD) / (OUT_CENTER_LEVEL_VOLTAGE - OUT_LOW_CLIP_THRESHOLD)) - 1) * 32767;
+
+	Rsamples sam;
+	sam.s1=sample;
+	sam.s2=m_vco_cap_voltage;
 
-			case 0:     /* inhibit */
-						out = 0;
-						break;
+	return(sam);
 
-			default:
-				out = 0;
-				break;
+}
+
+
+
+/* The same sub-step loop as render() on Q32 integers, with every cap moving
+   by a constant step like the linear engine.  Only the tap handed to a
+   driven chip and the returned sample are doubles, and both are exact
+   functions of the integers.  Not traced. */
+template <uint32_t MIXER, uint32_t ENVELOPE>
+SN76477_FORCE_INLINE Rsamples sn76477_device::render_fixed()
+{
+	static constexpr int64_t ONE_SHOT_MIN_Q = Q32(ONE_SHOT_CAP_VOLTAGE_MIN);
+	static constexpr int64_t ONE_SHOT_MAX_Q = Q32(ONE_SHOT_CAP_VOLTAGE_MAX);
+	static constexpr int64_t SLF_MIN_Q = Q32(SLF_CAP_VOLTAGE_MIN);
+	static constexpr int64_t SLF_MAX_Q = Q32(SLF_CAP_VOLTAGE_MAX);
+	static constexpr int64_t SLF_RANGE_Q = SLF_MAX_Q - SLF_MIN_Q;
+	static constexpr int64_t VCO_DIFF_Q = Q32(VCO_TO_SLF_VOLTAGE_DIFF);
+	static constexpr int64_t VCO_MIN_Q = Q32(VCO_CAP_VOLTAGE_MIN);
+	static constexpr int64_t VCO_MAX_Q = Q32(VCO_CAP_VOLTAGE_MAX);
+	static constexpr int64_t NOISE_MIN_Q = Q32(NOISE_CAP_VOLTAGE_MIN);
+	static constexpr int64_t NOISE_MAX_Q = Q32(NOISE_CAP_VOLTAGE_MAX);
+	static constexpr int64_t NOISE_HIGH_Q = Q32(NOISE_CAP_HIGH_THRESHOLD);
+	static constexpr int64_t NOISE_LOW_Q = Q32(NOISE_CAP_LOW_THRESHOLD);
+	static constexpr int64_t AD_MIN_Q = Q32(AD_CAP_VOLTAGE_MIN);
+	static constexpr int64_t AD_MAX_Q = Q32(AD_CAP_VOLTAGE_MAX);
+	static constexpr int64_t OUT_CENTER_Q = Q32(OUT_CENTER_LEVEL_VOLTAGE);
+	static constexpr int64_t OUT_LOW_Q = Q32(OUT_LOW_CLIP_THRESHOLD);
+
+	const sn76477_steps &steps = m_steps;
+	const uint32_t noise_gen_freq = steps.noise_gen_freq;
+	const uint32_t noise_clock_step = steps.noise_clock_step;
+
+	int64_t one_shot_cap_voltage = to_fixed(m_one_shot_cap_voltage);
+	int64_t slf_cap_voltage = to_fixed(m_slf_cap_voltage);
+	int64_t vco_cap_voltage = to_fixed(m_vco_cap_voltage);
+	int64_t noise_filter_cap_voltage = to_fixed(m_noise_filter_cap_voltage);
+	int64_t attack_decay_cap_voltage = to_fixed(m_attack_decay_cap_voltage);
+	int64_t vco_cap_voltage_max;
+	int64_t voltage_out = OUT_CENTER_Q;
+	int attack_decay_cap_charging;
+
+	int substep = 0;
+	int samples = m_sub_steps;
+	while (samples--)
+	{
+		if (substep++ == m_trigger_substep)
+		{
+			/* the trigger resets the a/d cap through the member */
+			shot_trigger();
+			attack_decay_cap_voltage = to_fixed(m_attack_decay_cap_voltage);
+			m_trigger_substep = -1;
+		}
+
+		double link = 0;
+		if (m_link_in)
+		{
+			link = m_link_in->tap[substep - 1];
+
+			if (m_link_target == LINK_ONE_SHOT)
+			{
+				uint32_t gate = (link > 0.5);
+				if (gate && !m_link_gate)
+				{
+					shot_trigger();
+					attack_decay_cap_voltage = to_fixed(m_attack_decay_cap_voltage);
+				}
+				m_link_gate = gate;
+			}
+			else if (m_link_target == LINK_SLF)
+			{
+				slf_cap_voltage = SLF_MIN_Q + to_fixed(link * SLF_CAP_VOLTAGE_RANGE);
 			}
+		}
+
+		/* one-shot */
+		if (!m_one_shot_cap_voltage_ext && (m_sections & SECTION_ONE_SHOT))
+		{
+			if (m_one_shot_running_ff)
+				one_shot_cap_voltage = min_q(one_shot_cap_voltage + steps.one_shot_charge_q, ONE_SHOT_MAX_Q);
+			else
+				one_shot_cap_voltage = max_q(one_shot_cap_voltage - steps.one_shot_discharge_q, ONE_SHOT_MIN_Q);
+		}
+
+		if (one_shot_cap_voltage >= ONE_SHOT_MAX_Q)
+			m_one_shot_running_ff = 0;
+
+		/* SLF */
+		if (!m_slf_cap_voltage_ext && (m_sections & SECTION_SLF) && !(m_link_in && (m_link_target == LINK_SLF)))
+		{
+			if (!m_slf_out_ff)
+				slf_cap_voltage = min_q(slf_cap_voltage + steps.slf_charge_q, SLF_MAX_Q);
+			else
+				slf_cap_voltage = max_q(slf_cap_voltage - steps.slf_discharge_q, SLF_MIN_Q);
+		}
+
+		if (slf_cap_voltage >= SLF_MAX_Q)
+			m_slf_out_ff = 1;
+		else if (slf_cap_voltage <= SLF_MIN_Q)
+			m_slf_out_ff = 0;
+
+		/* VCO */
+		if (m_link_in && (m_link_target == LINK_VCO))
+			vco_cap_voltage_max = SLF_MIN_Q + to_fixed(link * SLF_CAP_VOLTAGE_RANGE) + VCO_DIFF_Q;
+		else if (m_vco_mode)
+			vco_cap_voltage_max = slf_cap_voltage + VCO_DIFF_Q;
+		else
+			vco_cap_voltage_max = VCO_DIFF_Q;
+
+		if (!m_vco_cap_voltage_ext && (m_sections & SECTION_VCO))
+		{
+			if (!m_vco_out_ff)
+				vco_cap_voltage = min_q(vco_cap_voltage + steps.vco_charge_q, vco_cap_voltage_max);
+			else
+				vco_cap_voltage = max_q(vco_cap_voltage - steps.vco_discharge_q, VCO_MIN_Q);
+		}
 
-			/* determine the OUT voltage from the attack/delay cap voltage and clip it */
-			if (out)
+		if (vco_cap_voltage >= vco_cap_voltage_max)
+		{
+			if (!m_vco_out_ff)
+				m_vco_alt_pos_edge_ff = !m_vco_alt_pos_edge_ff;
+
+			m_vco_out_ff = 1;
+		}
+		else if (vco_cap_voltage <= VCO_MIN_Q)
+		{
+			m_vco_out_ff = 0;
+		}
 
+		/* noise generator and filter */
+		if (m_sections & SECTION_NOISE)
+		{
+			while (!m_noise_clock_ext && (m_noise_gen_count <= noise_gen_freq))
 			{
-				voltage_out = OUT_CENTER_LEVEL_VOLTAGE + center_to_peak_voltage_out * out_pos_gain[(int)(m_attack_decay_cap_voltage * 10)],
-				voltage_out = min(voltage_out, OUT_HIGH_CLIP_THRESHOLD);
+				m_noise_gen_count = m_noise_gen_count + noise_clock_step;
+
+				m_real_noise_bit_ff = generate_next_real_noise_bit();
+			}
+
+			m_noise_gen_count = m_noise_gen_count - noise_gen_freq;
+			if(m_noise_gen_count >=1000000) m_noise_gen_count=noise_gen_freq+noise_clock_step+1;
+			m_noise_filter_cap_voltage_ext=0;
+
+			if (m_real_noise_bit_ff)
+				noise_filter_cap_voltage = min_q(noise_filter_cap_voltage + steps.noise_filter_charge_q, NOISE_MAX_Q);
+			else
+				noise_filter_cap_voltage = max_q(noise_filter_cap_voltage - steps.noise_filter_discharge_q, NOISE_MIN_Q);
+
+			if (noise_filter_cap_voltage >= NOISE_HIGH_Q)
+				m_filtered_noise_bit_ff = 0;
+			else if (noise_filter_cap_voltage <= NOISE_LOW_Q)
+				m_filtered_noise_bit_ff = 1;
+		}
+
+		/* a/d cap */
+		attack_decay_cap_charging = envelope_charging<ENVELOPE>(m_vco_out_ff, m_one_shot_running_ff, m_vco_alt_pos_edge_ff);
 
+		if (!m_attack_decay_cap_voltage_ext && (m_sections & SECTION_AD))
+		{
+			if (attack_decay_cap_charging)
+			{
+				if (steps.attack_decay_charge_q)
+					attack_decay_cap_voltage = min_q(attack_decay_cap_voltage + steps.attack_decay_charge_q, AD_MAX_Q);
+				else
+					attack_decay_cap_voltage = AD_MAX_Q;
 			}
 			else
 			{
-				voltage_out = OUT_CENTER_LEVEL_VOLTAGE + center_to_peak_voltage_out * out_neg_gain[(int)(m_attack_decay_cap_voltage * 10)],
-				voltage_out = max(voltage_out, OUT_LOW_CLIP_THRESHOLD);
+				if (steps.attack_decay_discharge_q)
+					attack_decay_cap_voltage = max_q(attack_decay_cap_voltage - steps.attack_decay_discharge_q, AD_MIN_Q);
+				else
+					attack_decay_cap_voltage = AD_MIN_Q;
 			}
 		}
-		else
-		{
-			/* disabled */
-			voltage_out = OUT_CENTER_LEVEL_VOLTAGE;
 
+		/* output */
+		if (!m_enable && (vco_cap_voltage <= VCO_MAX_Q))
+		{
+			uint32_t out = mixer_out<MIXER>(m_vco_out_ff, m_slf_out_ff, m_filtered_noise_bit_ff);
 
+			voltage_out = out_gain_lerp(out ? m_out_pos_q : m_out_neg_q, attack_decay_cap_voltage);
+		}
+		else
+		{
+			voltage_out = OUT_CENTER_Q;
 		}
 
+		if (m_link_out)
+		{
+			double tap;
 
-		/* convert it to a signed 16-bit sample,
-		   -32767 = OUT_LOW_CLIP_THRESHOLD
-		        0 = OUT_CENTER_LEVEL_VOLTAGE
-		    32767 = 2 * OUT_CENTER_LEVEL_VOLTAGE + OUT_LOW_CLIP_THRESHOLD
+			switch (m_link_source)
+			{
+			case LINK_SLF:
+				tap = (double)(slf_cap_voltage - SLF_MIN_Q) / SLF_RANGE_Q;
+				break;
 
-		              / Vout - Vmin    \
-		    sample = |  ----------- - 1 | * 32767
-		              \ Vcen - Vmin    /
-		 */
+			case LINK_OUT:
+				tap = (double)(voltage_out - OUT_LOW_Q) / (2 * (OUT_CENTER_Q - OUT_LOW_Q));
+				break;
 
+			default:
+				tap = (double)(vco_cap_voltage - VCO_MIN_Q) / (double)(vco_cap_voltage_max - VCO_MIN_Q);
+				break;
+			}
 
+			m_link_out->tap[substep - 1] = min(max(tap, 0), 1);
+		}
 	}
 
-	double sample=(((voltage_out - OUT_LOW_CLIP_THRESHOLD) / (OUT_CENTER_LEVEL_VOLTAGE - OUT_LOW_CLIP_THRESHOLD)) - 1) * 32767;
+#ifdef SOFTSN_TRACE
+	m_trace_sample++;
+#endif
+
+	m_one_shot_cap_voltage = from_fixed(one_shot_cap_voltage);
+	m_slf_cap_voltage = from_fixed(slf_cap_voltage);
+	m_vco_cap_voltage = from_fixed(vco_cap_voltage);
+	m_noise_filter_cap_voltage = from_fixed(noise_filter_cap_voltage);
+	m_attack_decay_cap_voltage = from_fixed(attack_decay_cap_voltage);
+
+	/* the same scaling as render(), in integers */
+	int64_t sample = (voltage_out - OUT_LOW_Q) * 32767 / (OUT_CENTER_Q - OUT_LOW_Q) - 32767;
 
 	Rsamples sam;
-	sam.s1=sample;
-	sam.s2=m_vco_cap_voltage;
+	sam.s1 = (double)sample;
+	sam.s2 = m_vco_cap_voltage;
 
 	return(sam);
+}
+
+
+
+template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+SN76477_FORCE_INLINE void sn76477_device::render_block(Rsamples *out, int count, const sn76477_controls &from,
+	const sn76477_controls &to, const float *trigger)
+{
+	/* the resistors that set a pitch move by a constant ratio per stair,
+	   the rest by a constant amount; the last stair lands exactly on 'to' */
+	int stairs = (count + BLOCK_STEP - 1) / BLOCK_STEP;
+	double vco_ratio = 1;
+	double slf_ratio = 1;
+	if ((from.vco_res != to.vco_res) && (from.vco_res > 0) && (to.vco_res > 0))
+		vco_ratio = FIXED ? portable_pow(to.vco_res / from.vco_res, 1.0 / stairs) : pow(to.vco_res / from.vco_res, 1.0 / stairs);
+	if ((from.slf_res != to.slf_res) && (from.slf_res > 0) && (to.slf_res > 0))
+		slf_ratio = FIXED ? portable_pow(to.slf_res / from.slf_res, 1.0 / stairs) : pow(to.slf_res / from.slf_res, 1.0 / stairs);
+	double vco_res = from.vco_res;
+	double slf_res = from.slf_res;
+
+	for (int n = 0; n < count; )
+	{
+		int stair_end = (count - n > BLOCK_STEP) ? n + BLOCK_STEP : count;
+		bool last = (stair_end == count);
+		double t = (double)stair_end / count;
+
+		vco_res = last ? to.vco_res : vco_res * vco_ratio;
+		slf_res = last ? to.slf_res : slf_res * slf_ratio;
+
+		/* pins that did not move leave their groups clean */
+		set_pin(m_vco_res, vco_res, DIRTY_VCO);
+		set_pin(m_slf_res, slf_res, DIRTY_SLF);
+		set_pin(m_noise_clock_res, from.noise_clock_res + (to.noise_clock_res - from.noise_clock_res) * t, DIRTY_NOISE);
+		set_pin(m_noise_filter_res, from.noise_filter_res + (to.noise_filter_res - from.noise_filter_res) * t, DIRTY_NOISE);
+		set_pin(m_decay_res, from.decay_res + (to.decay_res - from.decay_res) * t, DIRTY_AD);
+		set_pin(m_attack_res, from.attack_res + (to.attack_res - from.attack_res) * t, DIRTY_AD);
+		set_pin(m_pitch_voltage, from.pitch_voltage + (to.pitch_voltage - from.pitch_voltage) * t, DIRTY_VCO);
+		set_pin(m_one_shot_cap, from.one_shot_cap + (to.one_shot_cap - from.one_shot_cap) * t, DIRTY_ONE_SHOT);
+
+		/* the steps are recomputed by the first sample of the stair only */
+		for (; n < stair_end; n++)
+		{
+			if (trigger && (trigger[n] >= 0))
+				shot_trigger_at(trigger[n]);
+
+			out[n] = render<MIXER, ENVELOPE, FIXED>(1);
+		}
+	}
+}
+
+
+
+/*****************************************************************************
+ *
+ *  Runtime kernel dispatch
+ *
+ *****************************************************************************/
+
+#define SN76477_KERNEL_AVX2   __attribute__((target("avx2,fma")))
+#define SN76477_KERNEL_AVX512 __attribute__((target("avx512f,avx512vl,avx512dq,avx2,fma")))
+
+/* every kernel comes as a table of MODE_KERNELS entries, one per mode, then again for the fixed-point engine */
+#define SN76477_MODE_ROW(kernel, envelope, fixed) \
+	kernel<0, envelope, fixed>, kernel<1, envelope, fixed>, kernel<2, envelope, fixed>, kernel<3, envelope, fixed>, \
+	kernel<4, envelope, fixed>, kernel<5, envelope, fixed>, kernel<6, envelope, fixed>, kernel<7, envelope, fixed>
+#define SN76477_MODE_ROWS(kernel, fixed) \
+	SN76477_MODE_ROW(kernel, 0, fixed), SN76477_MODE_ROW(kernel, 1, fixed), \
+	SN76477_MODE_ROW(kernel, 2, fixed), SN76477_MODE_ROW(kernel, 3, fixed)
+#define SN76477_MODE_TABLE(kernel) \
+	{ SN76477_MODE_ROWS(kernel, false), SN76477_MODE_ROWS(kernel, true) }
+
+struct sn76477_kernel
+{
+	typedef Rsamples (*func)(sn76477_device &chip, int samples);
+	typedef void (*block_func)(sn76477_device &chip, Rsamples *out, int count, const sn76477_controls &from,
+		const sn76477_controls &to, const float *trigger);
+
+	template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+	static Rsamples generic(sn76477_device &chip, int samples)
+	{
+		return chip.render<MIXER, ENVELOPE, FIXED>(samples);
+	}
+
+	template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+	static void generic_block(sn76477_device &chip, Rsamples *out, int count, const sn76477_controls &from,
+		const sn76477_controls &to, const float *trigger)
+	{
+		chip.render_block<MIXER, ENVELOPE, FIXED>(out, count, from, to, trigger);
+	}
 
+#if SN76477_KERNEL_X86
+	template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+	SN76477_KERNEL_AVX2
+	static Rsamples avx2(sn76477_device &chip, int samples)
+	{
+		return chip.render<MIXER, ENVELOPE, FIXED>(samples);
+	}
+
+	template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+	SN76477_KERNEL_AVX2
+	static void avx2_block(sn76477_device &chip, Rsamples *out, int count, const sn76477_controls &from,
+		const sn76477_controls &to, const float *trigger)
+	{
+		chip.render_block<MIXER, ENVELOPE, FIXED>(out, count, from, to, trigger);
+	}
+
+	template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+	SN76477_KERNEL_AVX512
+	static Rsamples avx512(sn76477_device &chip, int samples)
+	{
+		return chip.render<MIXER, ENVELOPE, FIXED>(samples);
+	}
+
+	template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+	SN76477_KERNEL_AVX512
+	static void avx512_block(sn76477_device &chip, Rsamples *out, int count, const sn76477_controls &from,
+		const sn76477_controls &to, const float *trigger)
+	{
+		chip.render_block<MIXER, ENVELOPE, FIXED>(out, count, from, to, trigger);
+	}
+#endif
+
+	static const func *get(int kernel)
+	{
+		static const func generic_table[sn76477_device::MODE_KERNELS] = SN76477_MODE_TABLE(generic);
+#if SN76477_KERNEL_X86
+		static const func avx2_table[sn76477_device::MODE_KERNELS] = SN76477_MODE_TABLE(avx2);
+		static const func avx512_table[sn76477_device::MODE_KERNELS] = SN76477_MODE_TABLE(avx512);
+#endif
+
+		switch (kernel)
+		{
+#if SN76477_KERNEL_X86
+		case sn76477_device::KERNEL_AVX2:   return avx2_table;
+		case sn76477_device::KERNEL_AVX512: return avx512_table;
+#endif
+		default:                            return generic_table;
+		}
+	}
+
+	static const block_func *get_block(int kernel)
+	{
+		static const block_func generic_table[sn76477_device::MODE_KERNELS] = SN76477_MODE_TABLE(generic_block);
+#if SN76477_KERNEL_X86
+		static const block_func avx2_table[sn76477_device::MODE_KERNELS] = SN76477_MODE_TABLE(avx2_block);
+		static const block_func avx512_table[sn76477_device::MODE_KERNELS] = SN76477_MODE_TABLE(avx512_block);
+#endif
+
+		switch (kernel)
+		{
+#if SN76477_KERNEL_X86
+		case sn76477_device::KERNEL_AVX2:   return avx2_table;
+		case sn76477_device::KERNEL_AVX512: return avx512_table;
+#endif
+		default:                            return generic_table;
+		}
+	}
+};
+
+static int s_kernel_id = sn76477_device::KERNEL_GENERIC;
+static const sn76477_kernel::func *s_kernels = sn76477_kernel::get(sn76477_device::KERNEL_GENERIC);
+static const sn76477_kernel::block_func *s_block_kernels = sn76477_kernel::get_block(sn76477_device::KERNEL_GENERIC);
+
+
+Rsamples sn76477_device::sound_stream_update(int samples)
+{
+	RT_AUDIT_SCOPE();
+	return s_kernels[m_mode_kernel](*this, samples);
+}
+
+
+void sn76477_device::sound_stream_update_block(Rsamples *out, int count, const sn76477_controls &from,
+	const sn76477_controls &to, const float *trigger)
+{
+	RT_AUDIT_SCOPE();
+	s_block_kernels[m_mode_kernel](*this, out, count, from, to, trigger);
+}
+
+
+bool sn76477_device::kernel_supported(int kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_GENERIC:
+		return true;
+#if SN76477_KERNEL_X86
+	case KERNEL_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	case KERNEL_AVX512:
+		__builtin_cpu_init();
+		return kernel_supported(KERNEL_AVX2) &&
+			__builtin_cpu_supports("avx512f") &&
+			__builtin_cpu_supports("avx512vl") &&
+			__builtin_cpu_supports("avx512dq");
+#endif
+	default:
+		return false;
+	}
+}
+
+
+int sn76477_device::best_kernel()
+{
+	int kernel = KERNEL_COUNT - 1;
+
+	while (kernel > KERNEL_GENERIC && !kernel_supported(kernel))
+		kernel--;
+
+	return kernel;
+}
+
+
+void sn76477_device::select_kernel(int kernel)
+{
+	if (!kernel_supported(kernel))
+		kernel = KERNEL_GENERIC;
+
+	s_kernel_id = kernel;
+	s_kernels = sn76477_kernel::get(kernel);
+	s_block_kernels = sn76477_kernel::get_block(kernel);
+}
+
+
+int sn76477_device::selected_kernel()
+{
+	return s_kernel_id;
+}
+
+
+const char *sn76477_device::kernel_name(int kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_GENERIC: return "generic";
+	case KERNEL_AVX2:    return "avx2";
+	case KERNEL_AVX512:  return "avx512";
+	default:             return "unknown";
+	}
+}
+
+
+double sn76477_device::benchmark_kernel(int kernel, int sample_rate, int samples, uint32_t engine) /* in ns/sample */
+{
+	if (!kernel_supported(kernel) || samples <= 0)
+		return 0;
+
+	const sn76477_kernel::func *funcs = sn76477_kernel::get(kernel);
+
+	/* VCO modulated by the SLF, mixed with filtered noise: every section of the chip is busy */
+	sn76477_device chip;
+	chip.set_amp_res(100);
+	chip.set_feedback_res(100);
+	chip.set_m_our_sample_rate(sample_rate);
+	chip.device_start();
+	chip.set_vco_params(2.30, 0, 1.752);
+	chip.set_slf_params(CAP_U(.047), 1.283184);
+	chip.set_noise_params(RES_K(47), RES_K(470), CAP_P(470));
+	chip.set_decay_res(RES_M(10));
+	chip.set_attack_params(0.00000005, RES_K(10));
+	chip.set_pitch_voltage(2.30);
+	chip.set_mixer_params(1, 0, 1);
+	chip.set_envelope(0);
+	chip.set_vco_mode(1);
+	chip.set_oneshot_params(CAP_N(500), RES_M(5));
+	chip.set_engine(engine);
+
+	double sink = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	sn76477_kernel::func func = funcs[chip.m_mode_kernel];
+	for (int i = 0; i < samples; i++)
+		sink += func(chip, 1).s1;
+
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+	/* keep the loop from being optimized away */
+	volatile double result = sink;
+	(void)result;
+
+	return std::chrono::duration<double, std::nano>(stop - start).count() / samples;
 }
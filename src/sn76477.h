@@ -41,13 +41,132 @@
 #pragma once
 
 #include "stdint.h"
+#include "stddef.h"
 #include "rescap.h"
+#ifdef SOFTSN_TRACE
+#include "sntrace.hpp"
+#endif
 struct Rsamples
 {
      double s1;
      double s2;
 };
 
+/* the chip's internal state: everything that evolves while it runs */
+struct sn76477_state
+{
+	double one_shot_cap_voltage;
+	uint32_t one_shot_running_ff;
+	double slf_cap_voltage;
+	uint32_t slf_out_ff;
+	double vco_cap_voltage;
+	uint32_t vco_out_ff;
+	uint32_t vco_alt_pos_edge_ff;
+	double noise_filter_cap_voltage;
+	uint32_t real_noise_bit_ff;
+	uint32_t filtered_noise_bit_ff;
+	uint32_t noise_gen_count;
+	double attack_decay_cap_voltage;
+	uint32_t rng;
+	int trigger_substep;
+	uint32_t sections;
+	double one_shot_skipped;
+	double slf_skipped;
+};
+
+/* the chip's pin settings, as a snapshot that can be handed to another thread */
+struct sn76477_pins
+{
+	uint32_t enable;
+	uint32_t envelope_mode;
+	uint32_t vco_mode;
+	uint32_t mixer_a;
+	uint32_t mixer_b;
+	uint32_t mixer_c;
+	double one_shot_res;
+	double one_shot_cap;
+	double slf_res;
+	double slf_cap;
+	double vco_voltage;
+	double vco_res;
+	double vco_cap;
+	double pitch_voltage;
+	double noise_clock_res;
+	double noise_filter_res;
+	double noise_filter_cap;
+	double attack_res;
+	double decay_res;
+	double attack_decay_cap;
+	double amplitude_res;
+	double feedback_res;
+};
+
+/* one RC step: the cap voltage moves as v = v * mul + add */
+struct sn76477_rc
+{
+	double mul;
+	double add;
+};
+
+/* per-sample increments derived from the pins and the sample rate */
+struct sn76477_steps
+{
+	double one_shot_cap_charging_step;
+	double one_shot_cap_discharging_step;
+	double slf_cap_charging_step;
+	double slf_cap_discharging_step;
+	double vco_cap_charging_step;
+	double vco_cap_discharging_step;
+	uint32_t noise_gen_freq;
+	uint32_t noise_clock_step;        /* noise counter advance per sub-step */
+	double noise_filter_cap_charging_step;
+	double noise_filter_cap_discharging_step;
+	double attack_decay_cap_charging_step;
+	double attack_decay_cap_discharging_step;
+
+	/* the same steps as multiply-adds, linear or exponential depending on the engine */
+	sn76477_rc one_shot_charge;
+	sn76477_rc one_shot_discharge;
+	sn76477_rc slf_charge;
+	sn76477_rc slf_discharge;
+	sn76477_rc vco_charge;
+	sn76477_rc vco_discharge;
+	sn76477_rc noise_filter_charge;
+	sn76477_rc noise_filter_discharge;
+	sn76477_rc attack_decay_charge;
+	sn76477_rc attack_decay_discharge;
+
+	/* the same linear steps in Q32 fixed point for ENGINE_FIXED, where 0
+	   still means no current and anything else moves at least one LSB */
+	int64_t one_shot_charge_q;
+	int64_t one_shot_discharge_q;
+	int64_t slf_charge_q;
+	int64_t slf_discharge_q;
+	int64_t vco_charge_q;
+	int64_t vco_discharge_q;
+	int64_t noise_filter_charge_q;
+	int64_t noise_filter_discharge_q;
+	int64_t attack_decay_charge_q;
+	int64_t attack_decay_discharge_q;
+};
+
+/* pins that are ramped across a block by sound_stream_update_block() */
+struct sn76477_controls
+{
+	double vco_res;             /* ramped geometrically, it sets an exponential pitch */
+	double slf_res;             /* ramped geometrically, it sets an exponential pitch */
+	double noise_clock_res;
+	double noise_filter_res;
+	double decay_res;
+	double attack_res;
+	double pitch_voltage;
+	double one_shot_cap;
+};
+
+/* a whole chip setup with everything derived from it, see get_config() */
+struct sn76477_config;
+struct sn76477_link;
+
 /*****************************************************************************
  *
  *  Interface definition
@@ -60,51 +179,136 @@ public:
 	//sn76477_device();
 
 	void set_noise_clock_ext(uint32_t clock) { m_noise_clock_ext=clock; }
-	void set_m_our_sample_rate(uint32_t sample_rate) { m_our_sample_rate=sample_rate; }
+	void set_m_our_sample_rate(uint32_t sample_rate)
+	{
+		if ((int)sample_rate != m_our_sample_rate)
+			m_dirty |= DIRTY_STEPS;
+		m_our_sample_rate=sample_rate;
+	}
 
 	void set_noise_params(double clock_res, double filter_res, double filter_cap)
 	{
-		m_noise_clock_res = clock_res;
-		m_noise_filter_res = filter_res;
-		m_noise_filter_cap = filter_cap;
+		set_pin(m_noise_clock_res, clock_res, DIRTY_NOISE);
+		set_pin(m_noise_filter_res, filter_res, DIRTY_NOISE);
+		set_pin(m_noise_filter_cap, filter_cap, DIRTY_NOISE);
 	}
-	void set_decay_res(double decay_res) { m_decay_res = decay_res; }
+	void set_decay_res(double decay_res) { set_pin(m_decay_res, decay_res, DIRTY_AD); }
 	void set_attack_params(double decay_cap, double res)
 	{
-		m_attack_decay_cap = decay_cap;
-		m_attack_res = res;
+		set_pin(m_attack_decay_cap, decay_cap, DIRTY_AD);
+		set_pin(m_attack_res, res, DIRTY_AD);
 	}
-	void set_amp_res(double amp_res) { m_amplitude_res = amp_res; }
-	void set_feedback_res(double feedback_res) { m_feedback_res = feedback_res; }
+	void set_amp_res(double amp_res) { set_pin(m_amplitude_res, amp_res, DIRTY_OUT_GAIN); }
+	void set_feedback_res(double feedback_res) { set_pin(m_feedback_res, feedback_res, DIRTY_OUT_GAIN); }
 	void set_vco_params(double volt, double cap, double res)
 	{
-		m_vco_voltage = volt;
-		m_vco_cap = cap;
-		m_vco_res = res;
+		set_pin(m_vco_voltage, volt, DIRTY_VCO);
+		set_pin(m_vco_cap, cap, DIRTY_VCO);
+		set_pin(m_vco_res, res, DIRTY_VCO);
 	}
-	void set_pitch_voltage(double volt) { m_pitch_voltage = volt; }
+	void set_pitch_voltage(double volt) { set_pin(m_pitch_voltage, volt, DIRTY_VCO); }
 	void set_slf_params(double cap, double res)
 	{
-		m_slf_cap = cap;
-		m_slf_res = res;
+		set_pin(m_slf_cap, cap, DIRTY_SLF);
+		set_pin(m_slf_res, res, DIRTY_SLF);
 	}
 	void set_oneshot_params(double cap, double res)
 	{
-		m_one_shot_cap = cap;
-		m_one_shot_res = res;
+		set_pin(m_one_shot_cap, cap, DIRTY_ONE_SHOT);
+		set_pin(m_one_shot_res, res, DIRTY_ONE_SHOT);
+	}
+	void set_vco_mode(uint32_t mode)
+	{
+		if (mode != m_vco_mode)
+		{
+			m_dirty |= DIRTY_SECTIONS | DIRTY_VCO;
+			trace_mode(TRACE_MODE_VCO, mode);
+		}
+		m_vco_mode = mode;
 	}
-	void set_vco_mode(uint32_t mode) { m_vco_mode = mode; }
 
+	/* cap charging model: the original linear ramps, or every RC node
+	   settling exponentially toward its supply like the real circuit.
+	   ENGINE_FIXED runs the linear ramps on Q32 integers, and its setup
+	   only uses IEEE basic operations, so a render comes out bit-identical
+	   with any compiler and CPU (see the fixed-point kernel). */
+	enum
+	{
+		ENGINE_LINEAR = 0,
+		ENGINE_ANALOG,
+		ENGINE_FIXED,
+		ENGINES
+	};
+	void set_engine(uint32_t engine)
+	{
+		if (engine != m_engine)
+			m_dirty |= DIRTY_STEPS;
+		m_engine = engine;
+		update_mode_kernel();
+	}
 
-	void set_envelope(uint32_t mode) { m_envelope_mode = mode; }
+
+	void set_envelope(uint32_t mode)
+	{
+		if (mode != m_envelope_mode)
+		{
+			m_dirty |= DIRTY_SECTIONS;
+			trace_mode(TRACE_MODE_ENVELOPE, mode);
+		}
+		m_envelope_mode = mode;
+		update_mode_kernel();
+	}
 
 
 	void set_mixer_params(uint32_t a, uint32_t b, uint32_t c)
 	{
+		if ((a != m_mixer_a) || (b != m_mixer_b) || (c != m_mixer_c))
+		{
+			m_dirty |= DIRTY_SECTIONS;
+			trace_mode(TRACE_MODE_MIXER, (a & 1) | (b & 1) << 1 | (c & 1) << 2);
+		}
 		m_mixer_a = a;
 		m_mixer_b = b;
 		m_mixer_c = c;
+		update_mode_kernel();
+	}
+
+	/* which of the chip's outputs are actually listened to: OUT (pin 13)
+	   and the VCO cap voltage.  Sections that can't reach either are not
+	   simulated until they become reachable again. */
+	void set_outputs_connected(uint32_t out, uint32_t vco_cap)
+	{
+		if ((out != m_out_connected) || (vco_cap != m_vco_cap_connected))
+			m_dirty |= DIRTY_SECTIONS;
+		m_out_connected = out;
+		m_vco_cap_connected = vco_cap;
 	}
+	/* chains this chip to another inside the sub-step loop, the way boards
+	   wired one SN76477's caps into the next.  The driving chip writes its
+	   VCO cap, SLF cap or OUT voltage into 'link' every sub-step; the driven
+	   chip, rendered right after it for the same host sample, reads each
+	   sub-step's value back as its VCO control, its SLF cap voltage or a
+	   one-shot trigger.  A null link breaks the chain. */
+	enum
+	{
+		LINK_VCO = 0,       /* source: VCO cap; target: top of the VCO triangle, as the SLF sets it */
+		LINK_SLF,           /* source: SLF cap; target: SLF cap voltage */
+		LINK_OUT,           /* source: OUT voltage */
+		LINK_ONE_SHOT       /* target: one-shot trigger on each rise past half way */
+	};
+	void set_link_source(sn76477_link *link, uint32_t source)
+	{
+		if ((link != m_link_out) || (source != m_link_source))
+			m_dirty |= DIRTY_SECTIONS;
+		m_link_out = link;
+		m_link_source = source;
+	}
+	void set_link_target(const sn76477_link *link, uint32_t target)
+	{
+		m_link_in = link;
+		m_link_target = target;
+	}
+
 	void set_envelope_params(uint32_t env1, uint32_t env2)
 	{
 		m_envelope_1 = env1;
@@ -151,12 +355,137 @@ public:
 	virtual Rsamples sound_stream_update(int samples);
 	virtual void device_start();
 
+	/* renders 'count' samples in one call while ramping the control pins
+	   from 'from' to 'to'; trigger[n] >= 0 fires the one-shot that far into
+	   sample n (see shot_trigger_at()), trigger may be null.  The ramp moves
+	   in stairs of BLOCK_STEP samples, so moving pins cost one recompute per
+	   stair instead of one per sample. */
+	static constexpr int BLOCK_STEP = 8;
+	void sound_stream_update_block(Rsamples *out, int count, const sn76477_controls &from,
+		const sn76477_controls &to, const float *trigger);
+
+	void get_state(sn76477_state &state) const;
+	void set_state(const sn76477_state &state);
+	void get_pins(sn76477_pins &pins) const;
+	void set_pins(const sn76477_pins &pins);
+
+	/* bumped whenever a change to the emulation alters what it renders from
+	   the same pins, so renders stored on disk are made again */
+	static constexpr uint32_t RENDER_VERSION = 1;
+
+	/* the pins together with the steps and output gain computed from them,
+	   for the current clock, sub-steps and engine.  A config prepared on
+	   another chip (eg. off the audio thread) is loaded by set_config() with
+	   a plain copy and nothing recomputed; it is refused, returning false,
+	   if it was made for a different clock, sub-step count or engine. */
+	void get_config(sn76477_config &config);
+	bool set_config(const sn76477_config &config);
+
+	/* human readable diagnostics.  They are pure functions of a pin snapshot
+	   so they can run on any thread; each formats one line into 'buf' and
+	   returns its length like snprintf().  Times and frequencies are the ones
+	   the emulation actually produces. */
+	static int log_enable_line(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_mixer_mode(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_envelope_mode(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_vco_mode(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_one_shot_time(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_slf_freq(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_vco_pitch_voltage(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_vco_duty_cycle(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_vco_freq(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_vco_ext_voltage(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_noise_gen_freq(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_noise_filter_freq(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_attack_time(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_decay_time(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_voltage_out(const sn76477_pins &pins, char *buf, size_t size);
+	static int log_complete_state(const sn76477_pins &pins, char *buf, size_t size);  /* all of the above, one per line */
+
+	/* runtime CPU dispatch of the chip kernel; the same kernel body is
+	   compiled once per ISA level and the widest supported one is picked */
+	enum
+	{
+		KERNEL_GENERIC = 0,
+		KERNEL_AVX2,
+		KERNEL_AVX512,
+		KERNEL_COUNT
+	};
+	static int best_kernel();
+	static bool kernel_supported(int kernel);
+	static void select_kernel(int kernel);
+	static int selected_kernel();
+	static const char *kernel_name(int kernel);
+	static double benchmark_kernel(int kernel, int sample_rate, int samples, uint32_t engine = ENGINE_LINEAR); /* in ns/sample */
+
+	/* ideal free-running VCO frequency for the current pins, without the
+	   sub-step quantization of the emulation */
+	static double vco_frequency(const sn76477_pins &pins);
+	double vco_frequency() const
+	{
+		sn76477_pins pins;
+		get_pins(pins);
+		return vco_frequency(pins);
+	}
+
+	/* true once the one-shot envelope has died away and OUT sits at its
+	   center level, so rendering this chip would only produce silence */
+	bool is_silent() const
+	{
+		return (m_envelope_mode == 1) && !m_one_shot_running_ff && (m_trigger_substep < 0) &&
+			(m_attack_decay_cap_voltage < 0.5);  /* both gain curves are flat zero below 0.7V */
+	}
+
 	void shot_trigger()
 	{
+#ifdef SOFTSN_TRACE
+		m_trace_triggered = true;
+#endif
 
 		m_attack_decay_cap_voltage = 0;
 		m_one_shot_running_ff = 1;
 	}
+	/* trigger the one-shot part way through the next sound_stream_update() call,
+	   0 = at its first sub-step, 1 = at the end of the host sample */
+	void shot_trigger_at(double fraction)
+	{
+		int substep = (int)(fraction * m_sub_steps);
+
+		substep = (substep < 0) ? 0 : (substep >= m_sub_steps) ? m_sub_steps - 1 : substep;
+		if ((m_trigger_substep < 0) || (substep < m_trigger_substep))
+			m_trigger_substep = substep;
+	}
+
+#ifdef SOFTSN_TRACE
+	/* record internal events into 'ring', null stops recording */
+	void set_trace(sntrace::Ring *ring) { m_trace = ring; }
+#endif
+
+	static constexpr int SUB_STEPS = 6;  /* chip steps per host sample */
+	static constexpr int MAX_SUB_STEPS = 16;  /* keeps the noise clock step well below its 1000000 reset */
+
+	/* trade accuracy for CPU; the step sizes are rescaled so every frequency
+	   and time constant stays the same as with SUB_STEPS */
+	void set_sub_steps(int sub_steps)
+	{
+		sub_steps = (sub_steps < 1) ? 1 : (sub_steps > MAX_SUB_STEPS) ? MAX_SUB_STEPS : sub_steps;
+		if (sub_steps != m_sub_steps)
+			m_dirty |= DIRTY_STEPS;
+		m_sub_steps = sub_steps;
+		if (m_trigger_substep >= m_sub_steps)
+			m_trigger_substep = m_sub_steps - 1;
+	}
+	/* OUT voltage for a given attack/decay cap voltage, linearly interpolated
+	   from one of the precomputed tables below */
+	static constexpr int OUT_GAIN_STEPS_PER_VOLT = 64;
+	static constexpr int OUT_GAIN_TABLE_SIZE = 4 * OUT_GAIN_STEPS_PER_VOLT + OUT_GAIN_STEPS_PER_VOLT / 2 + 1;  /* 0 - 4.5V */
+
+	static double out_gain_lerp(const double *table, double ad_cap_voltage);
+	static void out_gain_lerp(const double *table, const double *ad_cap_voltage, double *out, int count);
+	static int64_t out_gain_lerp(const int64_t *table, int64_t ad_cap_voltage);   /* Q32 */
+
+	friend struct sn76477_kernel;
+
 protected:
 	// device-level overrides
 //	virtual void device_start() override;
@@ -170,36 +499,37 @@ private:
 	uint32_t m_enable;
 	uint32_t m_envelope_mode;
 	uint32_t m_vco_mode;
-	uint32_t m_mixer_mode;
+	uint32_t m_mixer_mode = 0;
+	uint32_t m_mode_kernel = 0;             /* mixer mode | envelope << 3 | fixed << 5, see update_mode_kernel() */
 	int counter;
-	double m_one_shot_res;
-	double m_one_shot_cap;
+	double m_one_shot_res = 0;
+	double m_one_shot_cap = 0;
 	uint32_t m_one_shot_cap_voltage_ext;
 
-	double m_slf_res;
-	double m_slf_cap;
+	double m_slf_res = 0;
+	double m_slf_cap = 0;
 	uint32_t m_slf_cap_voltage_ext;
 
-	double m_vco_voltage;
-	double m_vco_res;
-	double m_vco_cap;
+	double m_vco_voltage = 0;
+	double m_vco_res = 0;
+	double m_vco_cap = 0;
 	uint32_t m_vco_cap_voltage_ext;
 
-	double m_noise_clock_res;
+	double m_noise_clock_res = 0;
 	uint32_t m_noise_clock_ext;
 	uint32_t m_noise_clock;
-	double m_noise_filter_res;
-	double m_noise_filter_cap;
+	double m_noise_filter_res = 0;
+	double m_noise_filter_cap = 0;
 	uint32_t m_noise_filter_cap_voltage_ext;
 
-	double m_attack_res;
-	double m_decay_res;
-	double m_attack_decay_cap;
+	double m_attack_res = 0;
+	double m_decay_res = 0;
+	double m_attack_decay_cap = 0;
 	uint32_t m_attack_decay_cap_voltage_ext;
 
-	double m_amplitude_res;
-	double m_feedback_res;
-	double m_pitch_voltage;
+	double m_amplitude_res = 0;
+	double m_feedback_res = 0;
+	double m_pitch_voltage = 0;
 
 	// internal state
 	double m_one_shot_cap_voltage;        /* voltage on the one-shot cap */
@@ -218,52 +548,135 @@ private:
 	uint32_t m_noise_gen_count;             /* noise freq emulation */
 
 	double m_attack_decay_cap_voltage;    /* voltage on the attack/decay cap */
+	int m_trigger_substep = -1;             /* sub-step of a pending one-shot trigger, -1 = none */
+	sn76477_link *m_link_out = nullptr;     /* chip this one drives, see set_link_source() */
+	uint32_t m_link_source = LINK_VCO;
+	const sn76477_link *m_link_in = nullptr;    /* chip driving this one, see set_link_target() */
+	uint32_t m_link_target = LINK_VCO;
+	uint32_t m_link_gate = 0;               /* link above half way, for the one-shot target */
 	double step_ext;
 	uint32_t m_rng;                         /* current value of the random number generator */
 
 	// configured by the drivers and used to setup m_mixer_mode & m_envelope_mode at start
-	uint32_t m_mixer_a;
-	uint32_t m_mixer_b;
-	uint32_t m_mixer_c;
+	uint32_t m_mixer_a = 0;
+	uint32_t m_mixer_b = 0;
+	uint32_t m_mixer_c = 0;
 	uint32_t m_envelope_1;
 	uint32_t m_envelope_2;
 	uint32_t m_envelope;
 
+	/* derived values that are only recomputed when their inputs change */
+	enum
+	{
+		DIRTY_OUT_GAIN = 1 << 0,
+		DIRTY_SECTIONS = 1 << 1,
+		DIRTY_ONE_SHOT = 1 << 2,
+		DIRTY_SLF      = 1 << 3,
+		DIRTY_VCO      = 1 << 4,
+		DIRTY_NOISE    = 1 << 5,
+		DIRTY_AD       = 1 << 6,
+		DIRTY_STEPS    = DIRTY_ONE_SHOT | DIRTY_SLF | DIRTY_VCO | DIRTY_NOISE | DIRTY_AD,
+		DIRTY_ALL      = DIRTY_OUT_GAIN | DIRTY_SECTIONS | DIRTY_STEPS
+	};
+	uint32_t m_dirty = DIRTY_ALL;
+	uint32_t m_engine = ENGINE_LINEAR;
+	sn76477_steps m_steps;
+
+	/* pins are clamped well past the point where every formula has saturated,
+	   so no section ever sees an infinite or subnormal rate; a NaN pin, which
+	   would never compare equal and recompute every sample, reads as open */
+	static constexpr double PIN_LIMIT = 1e30;
+	void set_pin(double &pin, double value, uint32_t group)
+	{
+		if (value != value)
+			value = 0;
+		else if (value > PIN_LIMIT)
+			value = PIN_LIMIT;
+		else if (value < -PIN_LIMIT)
+			value = -PIN_LIMIT;
+
+		if (value != pin)
+		{
+#ifdef SOFTSN_TRACE
+			/* once per group until the chip has caught up with it */
+			if (m_trace && !(m_dirty & group) && m_trace->pins.load(std::memory_order_relaxed))
+				m_trace->record(m_trace_sample, 0, sntrace::PIN, group, value);
+#endif
+			m_dirty |= group;
+		}
+		pin = value;
+	}
+
+	/* event tracing, see sntrace.hpp; compiled out unless SOFTSN_TRACE is defined */
+	enum
+	{
+		TRACE_MODE_MIXER = 0,
+		TRACE_MODE_ENVELOPE,
+		TRACE_MODE_VCO
+	};
+	void trace_mode(uint32_t which, uint32_t mode)
+	{
+#ifdef SOFTSN_TRACE
+		if (m_trace)
+			m_trace->record(m_trace_sample, 0, sntrace::MODE, which, mode);
+#else
+		(void)which;
+		(void)mode;
+#endif
+	}
+#ifdef SOFTSN_TRACE
+	sntrace::Ring *m_trace = nullptr;
+	uint64_t m_trace_sample = 0;              /* host samples rendered */
+	uint32_t m_trace_state = 0;               /* traced flip-flops after the last sub-step */
+	bool m_trace_triggered = false;
+	void trace_substep(int substep, uint32_t attack_decay_cap_charging);
+#endif
+
+	double m_center_to_peak_voltage_out;
+	int64_t m_out_pos_q[OUT_GAIN_TABLE_SIZE];   /* the same tables in Q32, for ENGINE_FIXED */
+	int64_t m_out_neg_q[OUT_GAIN_TABLE_SIZE];
+	double m_out_pos_voltage[OUT_GAIN_TABLE_SIZE];  /* OUT voltage when the mixer is high, clipped */
+	double m_out_neg_voltage[OUT_GAIN_TABLE_SIZE];  /* OUT voltage when the mixer is low, clipped */
+
+	/* sections of the chip that are simulated, see update_sections() */
+	enum
+	{
+		SECTION_ONE_SHOT = 1 << 0,
+		SECTION_SLF      = 1 << 1,
+		SECTION_VCO      = 1 << 2,
+		SECTION_NOISE    = 1 << 3,
+		SECTION_AD       = 1 << 4,
+		SECTION_ALL      = SECTION_ONE_SHOT | SECTION_SLF | SECTION_VCO | SECTION_NOISE | SECTION_AD
+	};
+	uint32_t m_sections = SECTION_ALL;
+	uint32_t m_out_connected = 1;
+	uint32_t m_vco_cap_connected = 1;
+	double m_one_shot_skipped = 0;          /* sub-steps the one-shot sat out, caught up on resync */
+	double m_slf_skipped = 0;               /* sub-steps the SLF sat out, caught up on resync */
+
 	/* others */
 //	sound_stream *m_channel;              /* returned by stream_create() */
-	int m_our_sample_rate;                    /* from machine.sample_rate() */
+	int m_our_sample_rate = 0;                /* from machine.sample_rate() */
+	int m_sub_steps = SUB_STEPS;              /* chip steps per host sample actually taken */
 
 //	wav_file *m_file;                     /* handle of the wave file to produce */
 
-	double compute_one_shot_cap_charging_rate();
-	double compute_one_shot_cap_discharging_rate();
-	double compute_slf_cap_charging_rate();
-	double compute_slf_cap_discharging_rate();
-	double compute_vco_cap_charging_discharging_rate();
-	double compute_vco_duty_cycle();
-	uint32_t compute_noise_gen_freq();
-	double compute_noise_filter_cap_charging_rate();
-	double compute_noise_filter_cap_discharging_rate();
-	double compute_attack_decay_cap_charging_rate();
-	double compute_attack_decay_cap_discharging_rate();
-	double compute_center_to_peak_voltage_out();
-
-	void log_enable_line();
-	void log_mixer_mode();
-	void log_envelope_mode();
-	void log_vco_mode();
-	void log_one_shot_time();
-	void log_slf_freq();
-	void log_vco_pitch_voltage();
-	void log_vco_duty_cycle();
-	void log_vco_freq();
-	void log_vco_ext_voltage();
-	void log_noise_gen_freq();
-	void log_noise_filter_freq();
-	void log_attack_time();
-	void log_decay_time();
-	void log_voltage_out();
-	void log_complete_state();
+	static double compute_one_shot_cap_charging_rate(const sn76477_pins &pins);
+	static double compute_one_shot_cap_discharging_rate(const sn76477_pins &pins);
+	static double compute_slf_cap_charging_rate(const sn76477_pins &pins);
+	static double compute_slf_cap_discharging_rate(const sn76477_pins &pins);
+	static double compute_vco_cap_charging_discharging_rate(const sn76477_pins &pins);
+	static double compute_vco_duty_cycle(const sn76477_pins &pins);
+	static uint32_t compute_noise_gen_freq(const sn76477_pins &pins, bool portable = false);
+	static double compute_noise_filter_cap_charging_rate(const sn76477_pins &pins);
+	static double compute_noise_filter_cap_discharging_rate(const sn76477_pins &pins);
+	static double compute_attack_decay_cap_charging_rate(const sn76477_pins &pins);
+	static double compute_attack_decay_cap_discharging_rate(const sn76477_pins &pins);
+	static double compute_center_to_peak_voltage_out(const sn76477_pins &pins);
+	void update_out_gain();
+	void update_steps();
+	uint32_t compute_live_sections();
+
 
 	void open_wav_file();
 	void close_wav_file();
@@ -272,9 +685,56 @@ private:
 	void intialize_noise();
 	inline uint32_t generate_next_real_noise_bit();
 
+	/* the render loop is compiled once per mixer and envelope mode and for
+	   the fixed-point engine, with the mode switches folded away; the mode
+	   and engine setters pick the one to run */
+	static constexpr int MODE_KERNELS = 8 * 4 * 2;
+	void update_mode_kernel()
+	{
+		uint32_t envelope = (m_envelope_mode <= 3) ? m_envelope_mode : 2;  /* anything else is mixer only */
+
+		m_mixer_mode = (m_mixer_a & 1) | (m_mixer_b << 1 & 2) | (m_mixer_c << 2 & 4);
+		m_mode_kernel = m_mixer_mode | envelope << 3 | (m_engine == ENGINE_FIXED) << 5;
+	}
+
+	inline void step_noise(uint32_t noise_gen_freq, uint32_t noise_clock_step,
+		const sn76477_rc &noise_filter_charge, const sn76477_rc &noise_filter_discharge);
+	template <uint32_t MIXER>
+	inline double mix_voltage_out();
+	template <uint32_t ENVELOPE>
+	inline bool render_ramps();
+	template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+	Rsamples render(int samples);
+	template <uint32_t MIXER, uint32_t ENVELOPE>
+	Rsamples render_fixed();
+	template <uint32_t MIXER, uint32_t ENVELOPE, bool FIXED>
+	void render_block(Rsamples *out, int count, const sn76477_controls &from,
+		const sn76477_controls &to, const float *trigger);
+
 	void state_save_register();
 };
 
+struct sn76477_config
+{
+	sn76477_pins pins;
+	int sample_rate;
+	int sub_steps;
+	uint32_t engine;
+	sn76477_steps steps;
+	double center_to_peak_voltage_out;
+	double out_pos_voltage[sn76477_device::OUT_GAIN_TABLE_SIZE];
+	double out_neg_voltage[sn76477_device::OUT_GAIN_TABLE_SIZE];
+	int64_t out_pos_q[sn76477_device::OUT_GAIN_TABLE_SIZE];
+	int64_t out_neg_q[sn76477_device::OUT_GAIN_TABLE_SIZE];
+};
+
+/* one host sample of a chip driving another, each sub-step's tap scaled to
+   0..1 over the range of the source */
+struct sn76477_link
+{
+	double tap[sn76477_device::MAX_SUB_STEPS];
+};
+
 
 
 #endif // MAME_SOUND_SN76477_H
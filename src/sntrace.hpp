@@ -0,0 +1,137 @@
+#pragma once
+
+// Event trace of the chip's internal state, built with `make TRACE=1`.
+//
+// The chip records flip-flop toggles, one-shot starts and ends, attack/decay
+// phase changes and pin changes into a fixed-size ring, each stamped with the
+// host sample and sub-step it happened on.  Recording is a few stores and
+// an increment, and in normal builds the hooks compile away entirely.  Pin
+// changes are opt-in, since CV in motion would otherwise flush the rest of
+// the history out of the ring within a second.
+//
+// The ring can be dumped to a compact binary file from any thread, and
+// tools/sn_trace2json.cpp turns that into Chrome trace JSON for
+// chrome://tracing or Perfetto.
+//
+// File layout, little endian: a FileHeader followed by `count` Events.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+namespace sntrace {
+
+enum EventType : uint8_t {
+	VCO_FF,           // value = new state of the VCO output flip-flop
+	SLF_FF,           // value = new state of the SLF output flip-flop
+	NOISE_FF,         // value = new state of the filtered noise bit
+	ONE_SHOT_START,   // value = one-shot cap voltage it restarted from
+	ONE_SHOT_END,
+	AD_PHASE,         // value = 1 attack, 0 decay
+	PIN,              // arg = sn76477_device dirty group, value = new pin value
+	MODE,             // arg = 0 mixer (A | B << 1 | C << 2), 1 envelope, 2 VCO mode
+	NUM_EVENT_TYPES
+};
+
+struct Event {
+	uint64_t sample;
+	uint8_t substep;
+	uint8_t type;
+	uint16_t arg;
+	float value;
+};
+
+struct FileHeader {
+	char magic[4];      // "SNTR"
+	uint32_t version;
+	uint32_t sampleRate;
+	uint32_t subSteps;
+	uint32_t count;
+};
+
+static const uint32_t VERSION = 1;
+
+static_assert(sizeof(Event) == 16, "an Event is stored as two words");
+
+// Single writer ring that keeps the newest CAPACITY events.  Each slot is
+// stamped with the index of the event it holds plus one, and zero while it
+// is being written, so a reader can tell a complete event from one the
+// writer is replacing under it.
+struct Ring {
+	static const uint32_t CAPACITY = 1 << 16;
+
+	struct Slot {
+		std::atomic<uint64_t> stamp {0};
+		std::atomic<uint64_t> words[2];
+	};
+
+	Slot slots[CAPACITY];
+	std::atomic<uint64_t> head {0};
+	std::atomic<bool> pins {false};     // record PIN events too
+
+	void record(uint64_t sample, int substep, EventType type, uint16_t arg, float value) {
+		Event e;
+		e.sample = sample;
+		e.substep = (uint8_t) substep;
+		e.type = type;
+		e.arg = arg;
+		e.value = value;
+		uint64_t words[2];
+		memcpy(words, &e, sizeof(e));
+
+		uint64_t h = head.load(std::memory_order_relaxed);
+		Slot& slot = slots[h & (CAPACITY - 1)];
+		slot.stamp.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.words[0].store(words[0], std::memory_order_relaxed);
+		slot.words[1].store(words[1], std::memory_order_relaxed);
+		slot.stamp.store(h + 1, std::memory_order_release);
+		head.store(h + 1, std::memory_order_release);
+	}
+
+	void clear() {
+		head.store(0, std::memory_order_release);
+	}
+
+	// Writes the ring oldest first.  Events the writer overwrote or was
+	// writing while they were being copied out are left out.
+	bool dump(const char* path, uint32_t sampleRate, uint32_t subSteps) const {
+		FILE* f = fopen(path, "wb");
+		if (!f)
+			return false;
+
+		uint64_t end = head.load(std::memory_order_acquire);
+		uint64_t begin = (end > CAPACITY) ? end - CAPACITY : 0;
+
+		FileHeader header = {{'S', 'N', 'T', 'R'}, VERSION, sampleRate, subSteps, 0};
+		fwrite(&header, sizeof(header), 1, f);
+
+		uint32_t count = 0;
+		for (uint64_t i = begin; i < end; i++) {
+			const Slot& slot = slots[i & (CAPACITY - 1)];
+			uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+			uint64_t words[2];
+			words[0] = slot.words[0].load(std::memory_order_relaxed);
+			words[1] = slot.words[1].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (stamp != i + 1 || slot.stamp.load(std::memory_order_relaxed) != stamp)
+				continue;
+
+			Event e;
+			memcpy(&e, words, sizeof(e));
+			fwrite(&e, sizeof(e), 1, f);
+			count++;
+		}
+
+		header.count = count;
+		fseek(f, 0, SEEK_SET);
+		fwrite(&header, sizeof(header), 1, f);
+
+		bool ok = !ferror(f);
+		fclose(f);
+		return ok;
+	}
+};
+
+}
@@ -1,6 +1,54 @@
 #include "softSN.hpp"
 #include "sn76477.h"
 #include "rescap.h"
+#include "rtaudit.hpp"
+#include "resampler.hpp"
+#include "wavetable.hpp"
+#include "shotcache.hpp"
+#include "triplebuffer.hpp"
+#include "expander.hpp"
+#include <memory>
+
+// Internal chip clock choices, 0 = follow the host
+static const int chipRates[] = {0, 44100, 48000, 96000};
+
+// Low CPU block sizes, 0 = render every sample as it is requested
+static const int blockSizes[] = {0, 16, 32, 64};
+
+// Size of the one-shot voice pool
+static const int voiceCounts[] = {1, 2, 4, 8};
+
+// Preset bank size, PRESET CV on the expander picks one per volt
+static const int NUM_PRESETS = 8;
+
+// Octaves the VCO and SLF resistors drop by when the SLF drives the VCO, so
+// the pitch stays about where the knob says
+static const double SLF_VCO_OCTAVES = 6.223494;
+
+// Dual-chip wiring: what chip A taps and where chip B takes it in
+struct DualRoute {
+	const char* name;
+	int source;
+	int target;
+};
+static const DualRoute dualRoutes[] = {
+	{"Off", -1, -1},
+	{"A VCO to B VCO", sn76477_device::LINK_VCO, sn76477_device::LINK_VCO},
+	{"A SLF to B VCO", sn76477_device::LINK_SLF, sn76477_device::LINK_VCO},
+	{"A OUT to B VCO", sn76477_device::LINK_OUT, sn76477_device::LINK_VCO},
+	{"A VCO to B SLF", sn76477_device::LINK_VCO, sn76477_device::LINK_SLF},
+	{"A OUT to B SLF", sn76477_device::LINK_OUT, sn76477_device::LINK_SLF},
+	{"A VCO triggers B", sn76477_device::LINK_VCO, sn76477_device::LINK_ONE_SHOT},
+	{"A SLF triggers B", sn76477_device::LINK_SLF, sn76477_device::LINK_ONE_SHOT},
+	{"A OUT triggers B", sn76477_device::LINK_OUT, sn76477_device::LINK_ONE_SHOT},
+};
+
+// Knob tooltips show what the chip makes of the knob, eg. the VCO frequency
+struct ChipParamQuantity : ParamQuantity {
+	int (*log)(const sn76477_pins& pins, char* buf, size_t size) = nullptr;
+
+	std::string getDescription() override;
+};
 
 struct SN_VCO: Module
 {
@@ -46,90 +94,820 @@ struct SN_VCO: Module
 	float sample = 0;
 	float output_power_normal = 0;
 	float K = 0;
+	float lastGate = 0;
+
+	// Fixed internal chip clock, resampled to the host rate
+	int chipRate = 0;
+	int appliedChipRate = -1;
+	PolyphaseResampler<2> resampler;
+
+	// Linear or exponential (analog) cap charging
+	int engine = sn76477_device::ENGINE_LINEAR;
+
+	// Low CPU mode: render blockSize samples ahead and stream them out
+	int blockMode = 0;
+	int blockSize = 0;
+	int blockPos = 0;
+	sn76477_controls blockControls;
+	Rsamples blockOut[64];
+	float blockTriggers[64];
+
+	// Band-limited table playback of the free-running VCO patch
+	bool wavetable = false;
+	VcoWavetable vcoTable;
+	double tablePhase = 0;
+
+	// One-shots played from the render cache file in the user folder
+	bool shotCacheOn = false;
+	OneShotCache shotCache;
+	OneShotCache::Hit shotHit;
+
+	// Pins of the main chip, published for the UI thread's diagnostics
+	TripleBuffer<sn76477_pins> pinsSnapshot;
+	int pinsCounter = 0;
+
+	// Pins the softSN Expander on the right can change, and its messages
+	SNExpanderPins expanderPins;
+	uint32_t expanderSerial = 0;
+	int expanderPreset = -1;
+	SNExpanderModes expanderModes;
+	SNExpanderMessage expanderMessages[2];
+
+	// This sample's knobs, with the mode switches rounded and any mode the
+	// expander's gates hold taken over
+	float knobs[NUM_PARAMS] = {};
+
+	// What a prepared chip configuration depends on besides the knobs.  The
+	// audio thread publishes it whenever it changes, for the UI thread to
+	// prepare the presets against.
+	struct ChipSetup {
+		int sampleRate = 0;
+		int engine = 0;
+		SNExpanderPins fixed;
+		bool operator!=(const ChipSetup& s) const {
+			return sampleRate != s.sampleRate || engine != s.engine || fixed != s.fixed;
+		}
+	};
+	ChipSetup chipSetup;
+	TripleBuffer<ChipSetup> chipSetupSnapshot;
+
+	// Preset bank.  The UI thread stores the knobs of a preset and prepares
+	// the chip configuration they make, the audio thread recalls it with a
+	// copy instead of a trip through the setters.
+	struct PresetSlot {
+		bool stored = false;
+		float values[NUM_PARAMS] = {};
+		ChipSetup setup;
+	};
+	struct Preset {
+		PresetSlot slot;
+		sn76477_config config;
+	};
+	PresetSlot presetSlots[NUM_PRESETS];
+	TripleBuffer<Preset> presets[NUM_PRESETS];
+	std::atomic<int> presetRequest {-1};
+	int pendingPreset = -1;
+	int currentPreset = -1;
+	bool presetOnTrigger = false;
+	int chipSampleRate = 0;
 
 	dsp::SchmittTrigger OneShotTrigger;
+	dsp::BooleanTrigger OneShotButton;
 
 	void onSampleRateChange() override;
+	void applyChipRate(float sampleRate);
+	void publishChipSetup();
+	static void roundModes(float* knob);
+	static void computeControls(const float* knob, const float* cv, sn76477_controls& c);
+	static void setChipPins(sn76477_device& chip, const float* knob, const sn76477_controls& c, const SNExpanderPins& fixed);
+	void captureControls(sn76477_controls& c);
+	void applyPins(sn76477_device& chip, const sn76477_controls& c, bool tapsOut, bool tapsVco);
+	void wireDualChip();
+	int allocateVoice(int count, int64_t frame);
+	Rsamples renderVoices(const sn76477_controls& c, int count);
+	void renderBlock();
+	void setWavetable(bool on);
+	void setShotCache(bool on);
+	void readExpander();
+	void readKnobs();
+	void storePreset(int index);
+	void preparePreset(int index);
+	void recallPreset(int index);
+	void refreshPresets();
+
+	// One-shot voice pool, voice 0 is the main chip that also feeds TRI
+	static const int MAX_VOICES = 8;
+	sn76477_device voices[MAX_VOICES];
+	sn76477_device& sn = voices[0];
+	int voiceMode = 0;
+	int64_t voiceStart[MAX_VOICES] = {};
+
+	// Dual-chip mode: the main chip is chip A and drives chip B through a
+	// link inside the sub-step loop.  Both share the knobs and CV, chip B
+	// plays on SQR.
+	sn76477_device chipB;
+	sn76477_link link;
+	int dualMode = 0;
+	int wiredDualMode = 0;
 
-	sn76477_device sn;
+#ifdef SOFTSN_TRACE
+	// Event trace of the main chip, dumped from the context menu
+	std::unique_ptr<sntrace::Ring> trace {new sntrace::Ring};
+#endif
 
 	SN_VCO() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
-		configParam(SN_VCO::m_noise_clock_res, 10000, 3300000, 0.0, "");
-		configParam(SN_VCO::m_noise_filter_res, 1, 100000000, 0.0, "");
-		configParam(SN_VCO::m_decay_res, 1, 20000000, 10000000, "");
-		configParam(SN_VCO::m_attack_res, 1, 5000000, 10, "");
-		configParam(SN_VCO::m_vco_res, 0, 8, 4, "");
-		configParam(SN_VCO::m_slf_res, 0, 16, 8, "");
-		configParam(SN_VCO::M_MIXER_A_PARAM, 0.0, 1.0, 1.0, "");
-		configParam(SN_VCO::M_MIXER_B_PARAM, 0.0, 1.0, 0.0, "");
-		configParam(SN_VCO::M_MIXER_C_PARAM, 0.0, 1.0, 0.0, "");
-		configParam(SN_VCO::VCO_SELECT_PARAM, 0.0, 1.0, 0.0, "");
-		configParam(SN_VCO::M_ENV_KNOB, 0, 3, 0, "");
+		configChipParam(SN_VCO::m_noise_clock_res, 10000, 3300000, 0.0, sn76477_device::log_noise_gen_freq);
+		configChipParam(SN_VCO::m_noise_filter_res, 1, 100000000, 0.0, sn76477_device::log_noise_filter_freq);
+		configChipParam(SN_VCO::m_decay_res, 1, 20000000, 10000000, sn76477_device::log_decay_time);
+		configChipParam(SN_VCO::m_attack_res, 1, 5000000, 10, sn76477_device::log_attack_time);
+		configChipParam(SN_VCO::m_vco_res, 0, 8, 4, sn76477_device::log_vco_freq);
+		configChipParam(SN_VCO::m_slf_res, 0, 16, 8, sn76477_device::log_slf_freq);
+		configChipParam(SN_VCO::M_MIXER_A_PARAM, 0.0, 1.0, 1.0, sn76477_device::log_mixer_mode);
+		configChipParam(SN_VCO::M_MIXER_B_PARAM, 0.0, 1.0, 0.0, sn76477_device::log_mixer_mode);
+		configChipParam(SN_VCO::M_MIXER_C_PARAM, 0.0, 1.0, 0.0, sn76477_device::log_mixer_mode);
+		configChipParam(SN_VCO::VCO_SELECT_PARAM, 0.0, 1.0, 0.0, sn76477_device::log_vco_mode);
+		configChipParam(SN_VCO::M_ENV_KNOB, 0, 3, 0, sn76477_device::log_envelope_mode);
 		configParam(SN_VCO::ONE_SHOT_PARAM, 0.0, 1.0, 0.0, "");
-		configParam(SN_VCO::ONE_SHOT_CAP_PARAM, 10, 2000, 500, "");
-		configParam(SN_VCO::m_pitch_voltage, 0, 4.55, 2.30, "");
-		sn.set_amp_res(100);
-		sn.set_feedback_res(100);
-		sn.set_m_our_sample_rate(APP->engine->getSampleRate());
-		sn.device_start();
+		configChipParam(SN_VCO::ONE_SHOT_CAP_PARAM, 10, 2000, 500, sn76477_device::log_one_shot_time);
+		configChipParam(SN_VCO::m_pitch_voltage, 0, 4.55, 2.30, sn76477_device::log_vco_duty_cycle);
+		rightExpander.producerMessage = &expanderMessages[0];
+		rightExpander.consumerMessage = &expanderMessages[1];
+		for (int v = 0; v < MAX_VOICES; v++)
+		{
+			voices[v].set_amp_res(expanderPins.amp_res);
+			voices[v].set_feedback_res(expanderPins.feedback_res);
+		}
+		chipB.set_amp_res(expanderPins.amp_res);
+		chipB.set_feedback_res(expanderPins.feedback_res);
+		applyChipRate(APP->engine->getSampleRate());
+		publishChipSetup();
+		for (int v = 0; v < MAX_VOICES; v++)
+			voices[v].device_start();
+		chipB.device_start();
+#ifdef SOFTSN_TRACE
+		sn.set_trace(trace.get());
+#endif
+	}
+#ifdef SOFTSN_RT_AUDIT
+	~SN_VCO() {
+		rtaudit::Counts c = rtaudit::counts();
+		INFO("softSN RT audit: %llu allocs, %llu frees, %llu locks on the audio path",
+			(unsigned long long) c.allocs, (unsigned long long) c.frees, (unsigned long long) c.locks);
+	}
+#endif
+	void configChipParam(int paramId, float minValue, float maxValue, float defaultValue,
+		int (*log)(const sn76477_pins&, char*, size_t)) {
+		configParam<ChipParamQuantity>(paramId, minValue, maxValue, defaultValue, "")->log = log;
 	}
 	void process(const ProcessArgs& args) override;
+	json_t* dataToJson() override;
+	void dataFromJson(json_t* rootJ) override;
 };
 
+std::string ChipParamQuantity::getDescription()
+{
+	SN_VCO* vco = dynamic_cast<SN_VCO*>(module);
+	if (!vco || !log)
+		return "";
+
+	char buf[128];
+	log(vco->pinsSnapshot.read(), buf, sizeof(buf));
+	return buf;
+}
+
 
 void SN_VCO::onSampleRateChange()
 {
-	sn.set_m_our_sample_rate(APP->engine->getSampleRate());
+	appliedChipRate = -1;
 }
 
-void SN_VCO::process(const ProcessArgs& args)
+void SN_VCO::applyChipRate(float sampleRate)
+{
+	int rate = chipRates[chipRate];
+	if (rate && rate != (int) sampleRate)
+	{
+		for (int v = 0; v < MAX_VOICES; v++)
+			voices[v].set_m_our_sample_rate(rate);
+		chipB.set_m_our_sample_rate(rate);
+		resampler.setRates(rate, sampleRate);
+		chipSampleRate = rate;
+	}
+	else
+	{
+		for (int v = 0; v < MAX_VOICES; v++)
+			voices[v].set_m_our_sample_rate(sampleRate);
+		chipB.set_m_our_sample_rate(sampleRate);
+		chipSampleRate = sampleRate;
+	}
+	appliedChipRate = chipRate;
+}
+
+// Audio thread: hands the clock, cap model and expander pins to the UI
+// thread when one of them has changed
+void SN_VCO::publishChipSetup()
+{
+	ChipSetup setup;
+	setup.sampleRate = chipSampleRate;
+	setup.engine = engine;
+	setup.fixed = expanderPins;
+	if (setup != chipSetup)
+	{
+		chipSetup = setup;
+		chipSetupSnapshot.write() = setup;
+		chipSetupSnapshot.publish();
+	}
+}
+
+// Chip and AGC state are saved with the patch so it comes back up in steady state
+static json_t* chipStateToJson(const sn76477_device& chip)
+{
+	sn76477_state st;
+	chip.get_state(st);
+
+	json_t* chipJ = json_object();
+	json_object_set_new(chipJ, "one_shot_cap_voltage", json_real(st.one_shot_cap_voltage));
+	json_object_set_new(chipJ, "one_shot_running_ff", json_integer(st.one_shot_running_ff));
+	json_object_set_new(chipJ, "slf_cap_voltage", json_real(st.slf_cap_voltage));
+	json_object_set_new(chipJ, "slf_out_ff", json_integer(st.slf_out_ff));
+	json_object_set_new(chipJ, "vco_cap_voltage", json_real(st.vco_cap_voltage));
+	json_object_set_new(chipJ, "vco_out_ff", json_integer(st.vco_out_ff));
+	json_object_set_new(chipJ, "vco_alt_pos_edge_ff", json_integer(st.vco_alt_pos_edge_ff));
+	json_object_set_new(chipJ, "noise_filter_cap_voltage", json_real(st.noise_filter_cap_voltage));
+	json_object_set_new(chipJ, "real_noise_bit_ff", json_integer(st.real_noise_bit_ff));
+	json_object_set_new(chipJ, "filtered_noise_bit_ff", json_integer(st.filtered_noise_bit_ff));
+	json_object_set_new(chipJ, "noise_gen_count", json_integer(st.noise_gen_count));
+	json_object_set_new(chipJ, "attack_decay_cap_voltage", json_real(st.attack_decay_cap_voltage));
+	json_object_set_new(chipJ, "rng", json_integer(st.rng));
+	return chipJ;
+}
+
+static void chipStateFromJson(json_t* chipJ, sn76477_device& chip)
+{
+	sn76477_state st;
+	chip.get_state(st);
+
+	json_t* j;
+	if ((j = json_object_get(chipJ, "one_shot_cap_voltage"))) st.one_shot_cap_voltage = json_number_value(j);
+	if ((j = json_object_get(chipJ, "one_shot_running_ff"))) st.one_shot_running_ff = json_integer_value(j);
+	if ((j = json_object_get(chipJ, "slf_cap_voltage"))) st.slf_cap_voltage = json_number_value(j);
+	if ((j = json_object_get(chipJ, "slf_out_ff"))) st.slf_out_ff = json_integer_value(j);
+	if ((j = json_object_get(chipJ, "vco_cap_voltage"))) st.vco_cap_voltage = json_number_value(j);
+	if ((j = json_object_get(chipJ, "vco_out_ff"))) st.vco_out_ff = json_integer_value(j);
+	if ((j = json_object_get(chipJ, "vco_alt_pos_edge_ff"))) st.vco_alt_pos_edge_ff = json_integer_value(j);
+	if ((j = json_object_get(chipJ, "noise_filter_cap_voltage"))) st.noise_filter_cap_voltage = json_number_value(j);
+	if ((j = json_object_get(chipJ, "real_noise_bit_ff"))) st.real_noise_bit_ff = json_integer_value(j);
+	if ((j = json_object_get(chipJ, "filtered_noise_bit_ff"))) st.filtered_noise_bit_ff = json_integer_value(j);
+	if ((j = json_object_get(chipJ, "noise_gen_count"))) st.noise_gen_count = json_integer_value(j);
+	if ((j = json_object_get(chipJ, "attack_decay_cap_voltage"))) st.attack_decay_cap_voltage = json_number_value(j);
+	if ((j = json_object_get(chipJ, "rng"))) st.rng = json_integer_value(j);
+
+	chip.set_state(st);
+}
+
+json_t* SN_VCO::dataToJson()
+{
+	json_t* rootJ = json_object();
+
+	// Chip B is saved alongside, so a dual chip patch resumes in lockstep
+	json_object_set_new(rootJ, "chip", chipStateToJson(sn));
+	json_object_set_new(rootJ, "chipB", chipStateToJson(chipB));
+
+	json_t* agcJ = json_object();
+	json_object_set_new(agcJ, "acc", json_integer(acc));
+	json_object_set_new(agcJ, "energy", json_real(energy));
+	json_object_set_new(agcJ, "K", json_real(K));
+	json_object_set_new(rootJ, "agc", agcJ);
+
+	json_object_set_new(rootJ, "chipRate", json_integer(chipRate));
+	json_object_set_new(rootJ, "engine", json_integer(engine));
+	json_object_set_new(rootJ, "blockMode", json_integer(blockMode));
+	json_object_set_new(rootJ, "voiceMode", json_integer(voiceMode));
+	json_object_set_new(rootJ, "dualMode", json_integer(dualMode));
+	json_object_set_new(rootJ, "wavetable", json_boolean(wavetable));
+	json_object_set_new(rootJ, "shotCache", json_boolean(shotCacheOn));
+
+	json_t* presetsJ = json_array();
+	for (int i = 0; i < NUM_PRESETS; i++)
+	{
+		if (!presetSlots[i].stored)
+		{
+			json_array_append_new(presetsJ, json_null());
+			continue;
+		}
+		json_t* valuesJ = json_array();
+		for (int p = 0; p < NUM_PARAMS; p++)
+			json_array_append_new(valuesJ, json_real(presetSlots[i].values[p]));
+		json_array_append_new(presetsJ, valuesJ);
+	}
+	json_object_set_new(rootJ, "presets", presetsJ);
+	json_object_set_new(rootJ, "presetOnTrigger", json_boolean(presetOnTrigger));
+
+	return rootJ;
+}
+
+void SN_VCO::dataFromJson(json_t* rootJ)
 {
-	params[M_MIXER_A_PARAM].setValue(round(params[M_MIXER_A_PARAM].getValue()));
-	params[M_MIXER_B_PARAM].setValue(round(params[M_MIXER_B_PARAM].getValue()));
-	params[M_MIXER_C_PARAM].setValue(round(params[M_MIXER_C_PARAM].getValue()));
-	params[M_ENV_KNOB].setValue(round(params[M_ENV_KNOB].getValue()));
-	params[VCO_SELECT_PARAM].setValue(round(params[VCO_SELECT_PARAM].getValue()));
+	json_t* chipJ = json_object_get(rootJ, "chip");
+	if (chipJ)
+		chipStateFromJson(chipJ, sn);
+
+	json_t* chipBJ = json_object_get(rootJ, "chipB");
+	if (chipBJ)
+		chipStateFromJson(chipBJ, chipB);
+
+	json_t* agcJ = json_object_get(rootJ, "agc");
+	if (agcJ)
+	{
+		json_t* j;
+		if ((j = json_object_get(agcJ, "acc"))) acc = json_integer_value(j);
+		if ((j = json_object_get(agcJ, "energy"))) energy = json_number_value(j);
+		if ((j = json_object_get(agcJ, "K"))) K = json_number_value(j);
+	}
+
+	json_t* chipRateJ = json_object_get(rootJ, "chipRate");
+	if (chipRateJ)
+		chipRate = clamp((int) json_integer_value(chipRateJ), 0, (int) LENGTHOF(chipRates) - 1);
+
+	json_t* engineJ = json_object_get(rootJ, "engine");
+	if (engineJ)
+		engine = clamp((int) json_integer_value(engineJ), (int) sn76477_device::ENGINE_LINEAR, (int) sn76477_device::ENGINE_FIXED);
 
+	json_t* blockModeJ = json_object_get(rootJ, "blockMode");
+	if (blockModeJ)
+		blockMode = clamp((int) json_integer_value(blockModeJ), 0, (int) LENGTHOF(blockSizes) - 1);
+
+	json_t* voiceModeJ = json_object_get(rootJ, "voiceMode");
+	if (voiceModeJ)
+		voiceMode = clamp((int) json_integer_value(voiceModeJ), 0, (int) LENGTHOF(voiceCounts) - 1);
+
+	json_t* dualModeJ = json_object_get(rootJ, "dualMode");
+	if (dualModeJ)
+		dualMode = clamp((int) json_integer_value(dualModeJ), 0, (int) LENGTHOF(dualRoutes) - 1);
+
+	json_t* wavetableJ = json_object_get(rootJ, "wavetable");
+	if (wavetableJ)
+		setWavetable(json_boolean_value(wavetableJ));
+
+	json_t* shotCacheJ = json_object_get(rootJ, "shotCache");
+	if (shotCacheJ)
+		setShotCache(json_boolean_value(shotCacheJ));
+
+	json_t* presetsJ = json_object_get(rootJ, "presets");
+	for (int i = 0; i < NUM_PRESETS && i < (int) json_array_size(presetsJ); i++)
+	{
+		json_t* valuesJ = json_array_get(presetsJ, i);
+		presetSlots[i].stored = json_is_array(valuesJ);
+		for (int p = 0; p < NUM_PARAMS && p < (int) json_array_size(valuesJ); p++)
+			presetSlots[i].values[p] = json_number_value(json_array_get(valuesJ, p));
+		preparePreset(i);
+	}
+
+	json_t* presetOnTriggerJ = json_object_get(rootJ, "presetOnTrigger");
+	if (presetOnTriggerJ)
+		presetOnTrigger = json_boolean_value(presetOnTriggerJ);
+}
+
+// The table builder thread only runs while the mode is on
+void SN_VCO::setWavetable(bool on)
+{
+	wavetable = on;
+	if (on)
+		vcoTable.start();
+	else
+		vcoTable.stop();
+}
+
+// Maps the cache file as soon as the mode is on, so hits play from the
+// first trigger after a patch loads; the renderer only runs while it is on
+void SN_VCO::setShotCache(bool on)
+{
+	if (on)
+	{
+		shotCacheOn = shotCache.start(asset::user("softSN-oneshots.bin"));
+		if (!shotCacheOn)
+			WARN("softSN one-shot cache could not be opened in %s", asset::user("").c_str());
+	}
+	else
+	{
+		shotCacheOn = false;
+		shotCache.stop();
+	}
+}
+
+// Knob values plus CV, in the chip's units
+void SN_VCO::computeControls(const float* knob, const float* cv, sn76477_controls& c)
+{
 	// Calculate VCO and SLF Oscillator Voltages
-	double volts = 1.752 * powf(2.0f, -1 * (inputs[EXT_VCO].getVoltage() + (params[m_vco_res].getValue() - 4 + (params[VCO_SELECT_PARAM].getValue() * 6.223494))));
-	double slf_volts = 1.283184 * powf(2.0f, -1 * (inputs[SLF_EXT].getVoltage() + (params[m_slf_res].getValue() - 8 + (params[VCO_SELECT_PARAM].getValue() * 6.223494))));
+	c.vco_res = 1.752 * powf(2.0f, -1 * (cv[EXT_VCO] + (knob[m_vco_res] - 4 + (knob[VCO_SELECT_PARAM] * SLF_VCO_OCTAVES))));
+	c.slf_res = 1.283184 * powf(2.0f, -1 * (cv[SLF_EXT] + (knob[m_slf_res] - 8 + (knob[VCO_SELECT_PARAM] * SLF_VCO_OCTAVES))));
 
 	// Applies parameters to SN76447 emulator
-	float attack_res = params[m_attack_res].getValue() + (((inputs[ATTACK_MOD_PARAM].getVoltage() * 20) / 100) * 5000000);
-	float decay_res = params[m_decay_res].getValue() + (((inputs[DECAY_MOD_PARAM].getVoltage() * 20) / 100) * 20000000);
-	float noise_clock_res = params[m_noise_clock_res].getValue() + (((inputs[NOISE_FREQ_MOD_PARAM].getVoltage() * 20) / 100) * 3300000);
-	float noise_filter_res = params[m_noise_filter_res].getValue() + (((inputs[NOISE_FILTER_MOD_PARAM].getVoltage() * 20) / 100) * 100000000);
-	float one_shot_length = ((params[ONE_SHOT_CAP_PARAM].getValue() ) + (((inputs[ONE_SHOT_LENGTH_MOD_PARAM].getVoltage() * 20) / 100) * 2000)) / 1000000000;
-	float duty_cycle = params[m_pitch_voltage].getValue() + (((inputs[DUTY_MOD_PARAM].getVoltage() * 20) / 100) * 4.55);
-
-	sn.set_vco_params(2.30, 0, volts);
-	sn.set_slf_params(CAP_U(.047), slf_volts);
-	sn.set_noise_params(noise_clock_res, noise_filter_res, CAP_P(470));
-	sn.set_decay_res(decay_res);
-	sn.set_attack_params(0.00000005, attack_res);
-	sn.set_pitch_voltage(duty_cycle);
-	sn.set_mixer_params(params[M_MIXER_A_PARAM].getValue(), params[M_MIXER_B_PARAM].getValue(), params[M_MIXER_C_PARAM].getValue());
-	sn.set_envelope(params[M_ENV_KNOB].getValue());
-	sn.set_vco_mode(params[VCO_SELECT_PARAM].getValue());
-	sn.set_oneshot_params(one_shot_length, 5000000);
-
-	// One Shot Trigger
-	if (params[ONE_SHOT_PARAM].getValue())
-		sn.shot_trigger();
-	if (OneShotTrigger.process(inputs[ONE_SHOT_GATE_PARAM].getVoltage()))
-		sn.shot_trigger();
+	c.attack_res = (float) (knob[m_attack_res] + (((cv[ATTACK_MOD_PARAM] * 20) / 100) * 5000000));
+	c.decay_res = (float) (knob[m_decay_res] + (((cv[DECAY_MOD_PARAM] * 20) / 100) * 20000000));
+	c.noise_clock_res = (float) (knob[m_noise_clock_res] + (((cv[NOISE_FREQ_MOD_PARAM] * 20) / 100) * 3300000));
+	c.noise_filter_res = (float) (knob[m_noise_filter_res] + (((cv[NOISE_FILTER_MOD_PARAM] * 20) / 100) * 100000000));
+	c.one_shot_cap = (float) (((knob[ONE_SHOT_CAP_PARAM] ) + (((cv[ONE_SHOT_LENGTH_MOD_PARAM] * 20) / 100) * 2000)) / 1000000000);
+	c.pitch_voltage = (float) (knob[m_pitch_voltage] + (((cv[DUTY_MOD_PARAM] * 20) / 100) * 4.55));
+}
 
-	// Attempt at AGC for TRI output.
+// The mixer, envelope and OSC switches only have whole positions
+void SN_VCO::roundModes(float* knob)
+{
+	knob[M_MIXER_A_PARAM] = round(knob[M_MIXER_A_PARAM]);
+	knob[M_MIXER_B_PARAM] = round(knob[M_MIXER_B_PARAM]);
+	knob[M_MIXER_C_PARAM] = round(knob[M_MIXER_C_PARAM]);
+	knob[M_ENV_KNOB] = round(knob[M_ENV_KNOB]);
+	knob[VCO_SELECT_PARAM] = round(knob[VCO_SELECT_PARAM]);
+}
+
+void SN_VCO::setChipPins(sn76477_device& chip, const float* knob, const sn76477_controls& c, const SNExpanderPins& fixed)
+{
+	chip.set_amp_res(fixed.amp_res);
+	chip.set_feedback_res(fixed.feedback_res);
+	chip.set_vco_params(2.30, 0, c.vco_res);
+	chip.set_slf_params(fixed.slf_cap, c.slf_res);
+	chip.set_noise_params(c.noise_clock_res, c.noise_filter_res, fixed.noise_filter_cap);
+	chip.set_decay_res(c.decay_res);
+	chip.set_attack_params(fixed.attack_decay_cap, c.attack_res);
+	chip.set_pitch_voltage(c.pitch_voltage);
+	chip.set_mixer_params(knob[M_MIXER_A_PARAM], knob[M_MIXER_B_PARAM], knob[M_MIXER_C_PARAM]);
+	chip.set_envelope(knob[M_ENV_KNOB]);
+	chip.set_vco_mode(knob[VCO_SELECT_PARAM]);
+	chip.set_oneshot_params(c.one_shot_cap, fixed.one_shot_res);
+}
+
+// Reads the knobs and CV into the pins that can be ramped across a block
+void SN_VCO::captureControls(sn76477_controls& c)
+{
+	float cv[NUM_INPUTS];
+	for (int i = 0; i < NUM_INPUTS; i++)
+		cv[i] = inputs[i].getVoltage();
+	computeControls(knobs, cv, c);
+}
+
+void SN_VCO::applyPins(sn76477_device& chip, const sn76477_controls& c, bool tapsOut, bool tapsVco)
+{
+	setChipPins(chip, knobs, c, expanderPins);
+	chip.set_engine(engine);
+	chip.set_outputs_connected(tapsOut && outputs[SINE_OUTPUT].isConnected(), tapsVco && outputs[TRI_OUTPUT].isConnected());
+}
+
+// Chains chip B to the main chip as the dual-chip menu asks
+void SN_VCO::wireDualChip()
+{
+	const DualRoute& route = dualRoutes[dualMode];
+	if (route.target < 0)
+	{
+		sn.set_link_source(nullptr, 0);
+		chipB.set_link_target(nullptr, 0);
+	}
+	else
+	{
+		sn.set_link_source(&link, route.source);
+		chipB.set_link_target(&link, route.target);
+	}
+	wiredDualMode = dualMode;
+}
+
+// UI thread: remembers the current knobs in a preset slot
+void SN_VCO::storePreset(int index)
+{
+	PresetSlot& slot = presetSlots[index];
+	for (int i = 0; i < NUM_PARAMS; i++)
+		slot.values[i] = params[i].getValue();
+	slot.stored = true;
+	preparePreset(index);
+}
+
+// UI thread: works out the chip configuration of a stored preset for the
+// current clock, engine and expander pins, and hands it to the audio thread
+void SN_VCO::preparePreset(int index)
+{
+	PresetSlot& slot = presetSlots[index];
+	slot.setup = chipSetupSnapshot.read();
+
+	Preset& preset = presets[index].write();
+	preset.slot = slot;
+	if (slot.stored)
+	{
+		float knob[NUM_PARAMS];
+		float cv[NUM_INPUTS] = {};
+		for (int i = 0; i < NUM_PARAMS; i++)
+			knob[i] = slot.values[i];
+		roundModes(knob);
+		sn76477_controls c;
+		computeControls(knob, cv, c);
+
+		sn76477_device chip;
+		chip.set_m_our_sample_rate(slot.setup.sampleRate);
+		chip.device_start();
+		setChipPins(chip, knob, c, slot.setup.fixed);
+		chip.set_engine(slot.setup.engine);
+		chip.get_config(preset.config);
+	}
+	presets[index].publish();
+}
+
+// UI thread: prepares again the presets whose configuration no longer
+// matches the chip, after a sample rate, cap model or expander change
+void SN_VCO::refreshPresets()
+{
+	const ChipSetup& setup = chipSetupSnapshot.read();
+	for (int i = 0; i < NUM_PRESETS; i++)
+	{
+		const PresetSlot& slot = presetSlots[i];
+		if (slot.stored && slot.setup != setup)
+			preparePreset(i);
+	}
+}
+
+// Moves the knobs to the preset and loads its prepared configuration into
+// every voice, so the next sample plays it with nothing to recompute
+void SN_VCO::recallPreset(int index)
+{
+	const Preset& preset = presets[index].read();
+	if (!preset.slot.stored)
+		return;
+
+	for (int i = 0; i < NUM_PARAMS; i++)
+	{
+		if (i != ONE_SHOT_PARAM)
+			params[i].setValue(preset.slot.values[i]);
+	}
+	readKnobs();
+
+	// A configuration prepared for another clock or engine is refused, and
+	// the setters catch up as usual until the UI prepares it again
+	for (int v = 0; v < MAX_VOICES; v++)
+		voices[v].set_config(preset.config);
+	chipB.set_config(preset.config);
+
+	if (blockSize)
+		captureControls(blockControls);
+	currentPreset = index;
+}
+
+// Picks up new pins when the expander has sent some, and goes back to the
+// defaults once it is removed.  Setting a pin to the value it already has
+// costs nothing, so only the sections whose pins moved are recomputed.
+void SN_VCO::readExpander()
+{
+	if (rightExpander.module && rightExpander.module->model == modelsoftSNExp)
+	{
+		const SNExpanderMessage* message = (const SNExpanderMessage*) rightExpander.consumerMessage;
+		if (message->serial != expanderSerial)
+		{
+			expanderPins = message->pins;
+			expanderModes = message->modes;
+			expanderSerial = message->serial;
+			if (message->preset != expanderPreset)
+			{
+				expanderPreset = message->preset;
+				if (expanderPreset >= 0)
+					pendingPreset = std::min(expanderPreset, NUM_PRESETS - 1);
+			}
+		}
+	}
+	else if (expanderSerial)
+	{
+		// A new expander counts its serials from 1 again
+		expanderPins = SNExpanderPins();
+		expanderModes = SNExpanderModes();
+		expanderSerial = 0;
+		expanderPreset = -1;
+		expanderMessages[0] = SNExpanderMessage();
+		expanderMessages[1] = SNExpanderMessage();
+	}
+}
+
+// Takes this sample's knobs, letting the expander's patched mode inputs
+// override the switches.  The chip's setters pick the matching render kernel
+// only when a mode actually changes.
+void SN_VCO::readKnobs()
+{
+	for (int i = 0; i < NUM_PARAMS; i++)
+		knobs[i] = params[i].getValue();
+	roundModes(knobs);
+
+	if (expanderModes.mixer_a >= 0)
+		knobs[M_MIXER_A_PARAM] = expanderModes.mixer_a;
+	if (expanderModes.mixer_b >= 0)
+		knobs[M_MIXER_B_PARAM] = expanderModes.mixer_b;
+	if (expanderModes.mixer_c >= 0)
+		knobs[M_MIXER_C_PARAM] = expanderModes.mixer_c;
+	if (expanderModes.envelope >= 0)
+		knobs[M_ENV_KNOB] = expanderModes.envelope;
+	if (expanderModes.vco_mode >= 0)
+		knobs[VCO_SELECT_PARAM] = expanderModes.vco_mode;
+}
+
+// Takes a silent voice if there is one, otherwise steals the oldest
+int SN_VCO::allocateVoice(int count, int64_t frame)
+{
+	int oldest = 0;
+	for (int v = 0; v < count; v++)
+	{
+		if (voices[v].is_silent())
+		{
+			oldest = v;
+			break;
+		}
+		if (voiceStart[v] < voiceStart[oldest])
+			oldest = v;
+	}
+	voiceStart[oldest] = frame;
+	return oldest;
+}
+
+// Sums the voices that are sounding; silent ones are not rendered at all
+Rsamples SN_VCO::renderVoices(const sn76477_controls& c, int count)
+{
+	Rsamples sum = {0, 0};
+	for (int v = 0; v < count; v++)
+	{
+		if (v > 0 && voices[v].is_silent())
+			continue;
+		applyPins(voices[v], c, !dualMode, v == 0);
+		Rsamples sam = voices[v].sound_stream_update(1);
+		sum.s1 += sam.s1;
+		if (v == 0)
+			sum.s2 = sam.s2;
+	}
+
+	// Chip B runs right after chip A, reading the link chip A just wrote.
+	// Driving its VCO works like the OSC switch on SLF, so its resistor
+	// drops by the same octaves.
+	if (dualMode)
+	{
+		sn76477_controls cb = c;
+		if (dualRoutes[dualMode].target == sn76477_device::LINK_VCO && !knobs[VCO_SELECT_PARAM])
+			cb.vco_res *= std::pow(2.0, -SLF_VCO_OCTAVES);
+		applyPins(chipB, cb, true, false);
+		sum.s1 = chipB.sound_stream_update(1).s1;
+	}
+	return sum;
+}
+
+// Renders the next block, ramping from the controls of the last one to now
+void SN_VCO::renderBlock()
+{
+	sn76477_controls controls;
+	captureControls(controls);
+	applyPins(sn, controls, true, true);
+
+	sn.sound_stream_update_block(blockOut, blockSize, blockControls, controls, blockTriggers);
+
+	blockControls = controls;
+	for (int i = 0; i < blockSize; i++)
+		blockTriggers[i] = -1.f;
+	blockPos = 0;
+}
+
+void SN_VCO::process(const ProcessArgs& args)
+{
+	RT_AUDIT_SCOPE();
 
-	Rsamples sam = sn.sound_stream_update(1);
+	if (chipRate != appliedChipRate)
+		applyChipRate(args.sampleRate);
+	readExpander();
+	publishChipSetup();
+	readKnobs();
+	if (dualMode != wiredDualMode)
+		wireDualChip();
+	bool resampled = chipRates[chipRate] && chipRates[chipRate] != (int) args.sampleRate;
+
+	// The voice pool only plays in one-shot envelope mode, and not in dual-chip mode
+	int voiceCount = (knobs[M_ENV_KNOB] == 1 && !dualMode) ? voiceCounts[voiceMode] : 1;
+
+	// Block rendering follows the host clock and drives a single chip, so it is
+	// bypassed while resampling or playing several voices or chips
+	int size = (resampled || voiceCount > 1 || dualMode) ? 0 : blockSizes[blockMode];
+	if (size != blockSize)
+	{
+		blockSize = size;
+		blockPos = size;
+		captureControls(blockControls);
+		for (int i = 0; i < size; i++)
+			blockTriggers[i] = -1.f;
+	}
+
+	// One Shot Trigger.  The button fires once per press, holding it would
+	// otherwise take a new voice every sample.
+	float trigger = -1.f;
+	if (OneShotButton.process(params[ONE_SHOT_PARAM].getValue() > 0.f))
+		trigger = 0.f;
+	// Place gate edges between host samples by interpolating the 1V threshold crossing
+	float gate = inputs[ONE_SHOT_GATE_PARAM].getVoltage();
+	if (OneShotTrigger.process(gate))
+		trigger = (gate > lastGate) ? (1.f - lastGate) / (gate - lastGate) : 0.f;
+	lastGate = gate;
+
+	// Preset switches wait for the next trigger if asked to, so a new sound
+	// can start exactly on a hit
+	if (presetRequest.load(std::memory_order_relaxed) >= 0)
+		pendingPreset = presetRequest.exchange(-1, std::memory_order_relaxed);
+	if (pendingPreset >= 0 && (!presetOnTrigger || trigger >= 0.f))
+	{
+		recallPreset(pendingPreset);
+		pendingPreset = -1;
+	}
+
+	// With only the VCO on the mixer, no envelope and the SLF off, the output
+	// is periodic and can be played from the band-limited tables instead.  The
+	// tables are rendered at the default output gain.
+	const VcoWavetable::Table* table = nullptr;
+	sn76477_controls controls;
+	SNExpanderPins nominal;
+	if (wavetable && !dualMode && expanderPins.amp_res == nominal.amp_res && expanderPins.feedback_res == nominal.feedback_res && knobs[M_MIXER_A_PARAM] == 1 && knobs[M_MIXER_B_PARAM] == 0 &&
+		knobs[M_MIXER_C_PARAM] == 0 && knobs[M_ENV_KNOB] == 2 && knobs[VCO_SELECT_PARAM] == 0)
+	{
+		captureControls(controls);
+		table = vcoTable.update(VcoWavetable::makeKey(controls.pitch_voltage, engine));
+	}
+
+	Rsamples sam;
+	if (table)
+	{
+		applyPins(sn, controls, true, true);
+		double inc = sn.vco_frequency() * args.sampleTime;
+		float out, cap;
+		VcoWavetable::read(*table, tablePhase, inc, out, cap);
+		sam.s1 = out;
+		sam.s2 = cap;
+		tablePhase += inc;
+		tablePhase -= floor(tablePhase);
+	}
+	else if (blockSize)
+	{
+		// Triggers land at the same position one block later, like everything else
+		if (blockPos == blockSize)
+			renderBlock();
+		blockTriggers[blockPos] = trigger;
+		sam = blockOut[blockPos++];
+	}
+	else
+	{
+		captureControls(controls);
+
+		// A hit with pins the cache has seen before plays from the file, a
+		// new one plays on the chip while the cache renders it for next time
+		bool cacheable = shotCacheOn && !resampled && !dualMode && voiceCount == 1 && knobs[M_ENV_KNOB] == 1;
+		if (!cacheable)
+			shotHit = OneShotCache::Hit();
+
+		if (trigger >= 0.f)
+		{
+			shotHit = OneShotCache::Hit();
+			bool cached = false;
+			if (cacheable)
+			{
+				applyPins(sn, controls, true, true);
+				sn76477_pins pins;
+				sn.get_pins(pins);
+				OneShotCache::Key key;
+				OneShotCache::makeKey(key, pins, chipSampleRate, engine);
+				cached = shotCache.find(key, shotHit);
+			}
+
+			if (!cached)
+			{
+				voices[allocateVoice(voiceCount, args.frame)].shot_trigger_at(trigger);
+				// Unless chip A triggers it, chip B follows the trigger input too
+				if (dualMode && dualRoutes[dualMode].target != sn76477_device::LINK_ONE_SHOT)
+					chipB.shot_trigger_at(trigger);
+			}
+		}
+
+		if (shotCache.next(shotHit, sam))
+		{
+			// The chip sits out the hit, it was not triggered
+		}
+		else if (resampled)
+		{
+			float frame[2];
+			resampler.process([&](float* in) {
+				Rsamples chip = renderVoices(controls, voiceCount);
+				in[0] = chip.s1;
+				in[1] = chip.s2;
+			}, frame);
+			sam.s1 = frame[0];
+			sam.s2 = frame[1];
+		}
+		else
+		{
+			sam = renderVoices(controls, voiceCount);
+		}
+	}
+
+	// Attempt at AGC for TRI output.
 
 	double sine = (5.0 * (double) sam.s1 / 25000) + 1.3;
 	outputs[SINE_OUTPUT].setVoltage(sine);
 
 	triout = sam.s2;
 
-	if (params[VCO_SELECT_PARAM].getValue())
+	if (knobs[VCO_SELECT_PARAM])
 	{
 		sample = (float) triout - 1.5;
 	}
@@ -143,12 +921,14 @@ void SN_VCO::process(const ProcessArgs& args)
 	if (acc == 16000)
 	{
 		output_power_normal = (float) pow((double) 10, (double) (-30 / 10));
-		K = (float) sqrt((output_power_normal * 16000) / energy);
+		// A silent TRI would make the gain infinite and the output NaN
+		if (energy > 0)
+			K = (float) sqrt((output_power_normal * 16000) / energy);
 		energy = 0;
 		acc = 0;
 	}
 
-	if (!params[VCO_SELECT_PARAM].getValue())
+	if (!knobs[VCO_SELECT_PARAM])
 	{
 		outputs[TRI_OUTPUT].setVoltage((sample * K * 6000.5) - 190);
 	}
@@ -157,6 +937,14 @@ void SN_VCO::process(const ProcessArgs& args)
 		outputs[TRI_OUTPUT].setVoltage(sample * K * 100.5);
 	}
 
+	// Hand the pins to the UI a few hundred times a second, the readouts are
+	// worked out over there
+	if (++pinsCounter >= 256)
+	{
+		sn.get_pins(pinsSnapshot.write());
+		pinsSnapshot.publish();
+		pinsCounter = 0;
+	}
 }
 
 struct SN_VCOWidget : ModuleWidget {
@@ -198,6 +986,96 @@ struct SN_VCOWidget : ModuleWidget {
 		addOutput(createOutput<PJ301MPort>(SINE_POSITION, module, SN_VCO::SINE_OUTPUT));
 		addOutput(createOutput<PJ301MPort>(TRI_OUT_POSITION, module, SN_VCO::TRI_OUTPUT));
 	}
+
+	void step() override {
+		SN_VCO* module = dynamic_cast<SN_VCO*>(this->module);
+		if (module)
+			module->refreshPresets();
+		ModuleWidget::step();
+	}
+
+	void appendContextMenu(Menu* menu) override {
+		SN_VCO* module = dynamic_cast<SN_VCO*>(this->module);
+		if (!module)
+			return;
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createSubmenuItem("Chip readout", "", [=](Menu* menu) {
+			char buf[1024];
+			sn76477_device::log_complete_state(module->pinsSnapshot.read(), buf, sizeof(buf));
+			for (const char* line = buf; *line; ) {
+				const char* end = strchr(line, '\n');
+				menu->addChild(createMenuLabel(end ? std::string(line, end) : std::string(line)));
+				line = end ? end + 1 : line + strlen(line);
+			}
+		}));
+		menu->addChild(createSubmenuItem("Presets", "", [=](Menu* menu) {
+			for (int i = 0; i < NUM_PRESETS; i++) {
+				bool stored = module->presetSlots[i].stored;
+				std::string state = !stored ? "empty" : (i == module->currentPreset) ? "current" : "";
+				menu->addChild(createSubmenuItem(string::f("Preset %d", i + 1), state, [=](Menu* menu) {
+					menu->addChild(createMenuItem("Recall", "", [=]() { module->presetRequest = i; }, !stored));
+					menu->addChild(createMenuItem("Store current settings", "", [=]() { module->storePreset(i); }));
+				}));
+			}
+			menu->addChild(createBoolMenuItem("Switch on the next trigger", "",
+				[=]() { return module->presetOnTrigger; },
+				[=](bool on) { module->presetOnTrigger = on; }));
+		}));
+		menu->addChild(createIndexSubmenuItem("Chip clock", {"Host rate", "44.1 kHz", "48 kHz", "96 kHz"},
+			[=]() { return module->chipRate; },
+			[=](size_t i) { module->chipRate = i; }));
+		menu->addChild(createIndexSubmenuItem("Cap model", {"Linear (original)", "Analog (exponential RC)", "Fixed-point (bit-exact)"},
+			[=]() { return module->engine; },
+			[=](size_t i) { module->engine = i; }));
+		menu->addChild(createBoolMenuItem("Band-limited VCO wavetable", "",
+			[=]() { return module->wavetable; },
+			[=](bool on) { module->setWavetable(on); }));
+		menu->addChild(createBoolMenuItem("One-shot render cache", "",
+			[=]() { return module->shotCacheOn; },
+			[=](bool on) { module->setShotCache(on); }));
+		menu->addChild(createIndexSubmenuItem("One-shot voices", {"1", "2", "4", "8"},
+			[=]() { return module->voiceMode; },
+			[=](size_t i) { module->voiceMode = i; }));
+		std::vector<std::string> dualNames;
+		for (const DualRoute& route : dualRoutes)
+			dualNames.push_back(route.name);
+		menu->addChild(createIndexSubmenuItem("Dual chip", dualNames,
+			[=]() { return module->dualMode; },
+			[=](size_t i) { module->dualMode = i; }));
+		menu->addChild(createIndexSubmenuItem("Low CPU block rendering", {"Off", "16 samples", "32 samples", "64 samples"},
+			[=]() { return module->blockMode; },
+			[=](size_t i) { module->blockMode = i; }));
+		// The size process() actually renders with, 0 while block rendering is bypassed
+		int blockSize = module->blockSize;
+		if (module->blockMode && !blockSize)
+			menu->addChild(createMenuLabel("Bypassed: fixed chip clock, several voices or dual chip"));
+		else
+			menu->addChild(createMenuLabel(string::f("Latency: %d samples", blockSize)));
+
+#ifdef SOFTSN_RT_AUDIT
+		rtaudit::Counts c = rtaudit::counts();
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel(string::f("RT audit: %llu allocs, %llu frees, %llu locks",
+			(unsigned long long) c.allocs, (unsigned long long) c.frees, (unsigned long long) c.locks)));
+		menu->addChild(createMenuItem("Reset RT audit counters", "", []() { rtaudit::reset(); }));
+#endif
+
+#ifdef SOFTSN_TRACE
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createBoolMenuItem("Trace pin changes", "",
+			[=]() { return module->trace->pins.load(); },
+			[=](bool on) { module->trace->pins.store(on); }));
+		menu->addChild(createMenuItem("Dump event trace", "softSN-trace.bin", [=]() {
+			std::string path = asset::user("softSN-trace.bin");
+			int rate = chipRates[module->chipRate] ? chipRates[module->chipRate] : (int) APP->engine->getSampleRate();
+			if (module->trace->dump(path.c_str(), rate, sn76477_device::SUB_STEPS))
+				INFO("softSN event trace written to %s", path.c_str());
+			else
+				WARN("softSN event trace could not be written to %s", path.c_str());
+		}));
+#endif
+	}
 };
 
 Model *modelsoftSN = createModel<SN_VCO, SN_VCOWidget>("softSN");
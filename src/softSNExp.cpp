@@ -0,0 +1,159 @@
+#include "softSNExp.hpp"
+#include "expander.hpp"
+
+// Each pin is its softSN default scaled by 2^(knob + CV), so one volt is one
+// octave of resistance or capacitance, as on the VCO and SLF inputs
+static const float PIN_RANGE = 6.f;
+
+// Mode gates are high from 1V, like the one-shot trigger input
+static const float GATE_THRESHOLD = 1.f;
+
+struct SN_EXP: Module
+{
+	enum ParamIds
+	{
+		AMP_RES_PARAM, FEEDBACK_RES_PARAM, SLF_CAP_PARAM, NOISE_CAP_PARAM,
+		AD_CAP_PARAM, ONE_SHOT_RES_PARAM, NUM_PARAMS
+	};
+	enum InputIds
+	{
+		AMP_RES_INPUT, FEEDBACK_RES_INPUT, SLF_CAP_INPUT, NOISE_CAP_INPUT,
+		AD_CAP_INPUT, ONE_SHOT_RES_INPUT, PRESET_INPUT,
+		MIXER_A_INPUT, MIXER_B_INPUT, MIXER_C_INPUT, ENV_INPUT, VCO_SELECT_INPUT, NUM_INPUTS
+	};
+	enum OutputIds
+	{
+		NUM_OUTPUTS
+	};
+	enum LightIds
+	{
+		CONNECTED_LIGHT, NUM_LIGHTS
+	};
+
+	// Last pins sent, and which softSN they went to
+	SNExpanderPins sent;
+	int sentPreset = -1;
+	SNExpanderModes sentModes;
+	uint32_t serial = 0;
+	int64_t sentTo = -1;
+
+	SN_EXP() {
+		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		SNExpanderPins nominal;
+		configParam(AMP_RES_PARAM, -4.f, 4.f, 0.f, "Amplitude resistor (pin 11)", " Ω", 2.f, nominal.amp_res);
+		configParam(FEEDBACK_RES_PARAM, -4.f, 4.f, 0.f, "Feedback resistor (pin 12)", " Ω", 2.f, nominal.feedback_res);
+		configParam(SLF_CAP_PARAM, -4.f, 4.f, 0.f, "SLF capacitor (pin 21)", " µF", 2.f, nominal.slf_cap * 1e6);
+		configParam(NOISE_CAP_PARAM, -4.f, 4.f, 0.f, "Noise filter capacitor (pin 6)", " pF", 2.f, nominal.noise_filter_cap * 1e12);
+		configParam(AD_CAP_PARAM, -4.f, 4.f, 0.f, "Attack/decay capacitor (pin 8)", " µF", 2.f, nominal.attack_decay_cap * 1e6);
+		configParam(ONE_SHOT_RES_PARAM, -4.f, 4.f, 0.f, "One-shot resistor (pin 24)", " MΩ", 2.f, nominal.one_shot_res * 1e-6);
+		configInput(AMP_RES_INPUT, "Amplitude resistor CV");
+		configInput(FEEDBACK_RES_INPUT, "Feedback resistor CV");
+		configInput(SLF_CAP_INPUT, "SLF capacitor CV");
+		configInput(NOISE_CAP_INPUT, "Noise filter capacitor CV");
+		configInput(AD_CAP_INPUT, "Attack/decay capacitor CV");
+		configInput(ONE_SHOT_RES_INPUT, "One-shot resistor CV");
+		configInput(PRESET_INPUT, "Preset select, 1V per preset from 0V");
+		configInput(MIXER_A_INPUT, "Mixer A gate");
+		configInput(MIXER_B_INPUT, "Mixer B gate");
+		configInput(MIXER_C_INPUT, "Mixer C gate");
+		configInput(ENV_INPUT, "Envelope mode, 1V per mode from 0V");
+		configInput(VCO_SELECT_INPUT, "OSC gate, high selects SLF");
+	}
+
+	double pin(double nominal, int param, int input) {
+		float octaves = clamp(params[param].getValue() + inputs[input].getVoltage(), -PIN_RANGE, PIN_RANGE);
+		return (octaves == 0.f) ? nominal : nominal * std::pow(2.0, (double) octaves);
+	}
+
+	int gate(int input) {
+		if (!inputs[input].isConnected())
+			return -1;
+		return inputs[input].getVoltage() >= GATE_THRESHOLD;
+	}
+
+	void process(const ProcessArgs& args) override;
+};
+
+void SN_EXP::process(const ProcessArgs& args)
+{
+	Module* main = leftExpander.module;
+	bool attached = main && main->model == modelsoftSN;
+	lights[CONNECTED_LIGHT].setBrightness(attached);
+	if (!attached)
+	{
+		sentTo = -1;
+		return;
+	}
+
+	SNExpanderPins nominal;
+	SNExpanderPins pins;
+	pins.amp_res = pin(nominal.amp_res, AMP_RES_PARAM, AMP_RES_INPUT);
+	pins.feedback_res = pin(nominal.feedback_res, FEEDBACK_RES_PARAM, FEEDBACK_RES_INPUT);
+	pins.slf_cap = pin(nominal.slf_cap, SLF_CAP_PARAM, SLF_CAP_INPUT);
+	pins.noise_filter_cap = pin(nominal.noise_filter_cap, NOISE_CAP_PARAM, NOISE_CAP_INPUT);
+	pins.attack_decay_cap = pin(nominal.attack_decay_cap, AD_CAP_PARAM, AD_CAP_INPUT);
+	pins.one_shot_res = pin(nominal.one_shot_res, ONE_SHOT_RES_PARAM, ONE_SHOT_RES_INPUT);
+
+	int preset = inputs[PRESET_INPUT].isConnected() ? std::max((int) std::round(inputs[PRESET_INPUT].getVoltage()), 0) : -1;
+
+	SNExpanderModes modes;
+	modes.mixer_a = gate(MIXER_A_INPUT);
+	modes.mixer_b = gate(MIXER_B_INPUT);
+	modes.mixer_c = gate(MIXER_C_INPUT);
+	if (inputs[ENV_INPUT].isConnected())
+		modes.envelope = clamp((int) std::round(inputs[ENV_INPUT].getVoltage()), 0, 3);
+	modes.vco_mode = gate(VCO_SELECT_INPUT);
+
+	// Nothing moved, so softSN keeps reading the message it already has
+	if (pins == sent && preset == sentPreset && modes == sentModes && main->id == sentTo)
+		return;
+
+	// Rack swaps the buffers after this step, the chip sees the pins on the next sample
+	SNExpanderMessage* message = (SNExpanderMessage*) main->rightExpander.producerMessage;
+	message->serial = ++serial;
+	message->pins = pins;
+	message->preset = preset;
+	message->modes = modes;
+	main->rightExpander.requestMessageFlip();
+
+	sent = pins;
+	sentPreset = preset;
+	sentModes = modes;
+	sentTo = main->id;
+}
+
+struct SN_EXPWidget : ModuleWidget {
+	SN_EXPWidget(SN_EXP *module) {
+		setModule(module);
+
+		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/SNsoft_Expander.svg")));
+
+		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, 0)));
+		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+
+		addChild(createLightCentered<SmallLight<GreenLight>>(EXP_CONNECTED_POSITION, module, SN_EXP::CONNECTED_LIGHT));
+
+		addParam(createParam<Knob16>(EXP_AMP_RES_POSITION, module, SN_EXP::AMP_RES_PARAM));
+		addParam(createParam<Knob16>(EXP_FEEDBACK_RES_POSITION, module, SN_EXP::FEEDBACK_RES_PARAM));
+		addParam(createParam<Knob16>(EXP_SLF_CAP_POSITION, module, SN_EXP::SLF_CAP_PARAM));
+		addParam(createParam<Knob16>(EXP_NOISE_CAP_POSITION, module, SN_EXP::NOISE_CAP_PARAM));
+		addParam(createParam<Knob16>(EXP_AD_CAP_POSITION, module, SN_EXP::AD_CAP_PARAM));
+		addParam(createParam<Knob16>(EXP_ONE_SHOT_RES_POSITION, module, SN_EXP::ONE_SHOT_RES_PARAM));
+
+		addInput(createInput<PJ301MPort>(EXP_AMP_RES_CV_POSITION, module, SN_EXP::AMP_RES_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_FEEDBACK_RES_CV_POSITION, module, SN_EXP::FEEDBACK_RES_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_SLF_CAP_CV_POSITION, module, SN_EXP::SLF_CAP_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_NOISE_CAP_CV_POSITION, module, SN_EXP::NOISE_CAP_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_AD_CAP_CV_POSITION, module, SN_EXP::AD_CAP_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_ONE_SHOT_RES_CV_POSITION, module, SN_EXP::ONE_SHOT_RES_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_PRESET_POSITION, module, SN_EXP::PRESET_INPUT));
+
+		addInput(createInput<PJ301MPort>(EXP_MIXER_A_POSITION, module, SN_EXP::MIXER_A_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_MIXER_B_POSITION, module, SN_EXP::MIXER_B_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_MIXER_C_POSITION, module, SN_EXP::MIXER_C_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_ENV_POSITION, module, SN_EXP::ENV_INPUT));
+		addInput(createInput<PJ301MPort>(EXP_VCO_SELECT_POSITION, module, SN_EXP::VCO_SELECT_INPUT));
+	}
+};
+
+Model *modelsoftSNExp = createModel<SN_EXP, SN_EXPWidget>("softSNExp");
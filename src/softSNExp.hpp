@@ -0,0 +1,27 @@
+#pragma once
+
+#include "8mode.hpp"
+
+		auto EXP_CONNECTED_POSITION = mm2px(Vec(25.4, 9.5));
+
+		auto EXP_AMP_RES_POSITION = mm2px(Vec(4.2, 12.5));
+		auto EXP_FEEDBACK_RES_POSITION = mm2px(Vec(4.2, 28.5));
+		auto EXP_SLF_CAP_POSITION = mm2px(Vec(4.2, 44.5));
+		auto EXP_NOISE_CAP_POSITION = mm2px(Vec(4.2, 60.5));
+		auto EXP_AD_CAP_POSITION = mm2px(Vec(4.2, 76.5));
+		auto EXP_ONE_SHOT_RES_POSITION = mm2px(Vec(4.2, 92.5));
+
+		auto EXP_AMP_RES_CV_POSITION = mm2px(Vec(26.0, 16.3));
+		auto EXP_FEEDBACK_RES_CV_POSITION = mm2px(Vec(26.0, 32.3));
+		auto EXP_SLF_CAP_CV_POSITION = mm2px(Vec(26.0, 48.3));
+		auto EXP_NOISE_CAP_CV_POSITION = mm2px(Vec(26.0, 64.3));
+		auto EXP_AD_CAP_CV_POSITION = mm2px(Vec(26.0, 80.3));
+		auto EXP_ONE_SHOT_RES_CV_POSITION = mm2px(Vec(26.0, 96.3));
+
+		auto EXP_PRESET_POSITION = mm2px(Vec(21.4, 109.6));
+
+		auto EXP_MIXER_A_POSITION = mm2px(Vec(38.0, 16.3));
+		auto EXP_MIXER_B_POSITION = mm2px(Vec(38.0, 32.3));
+		auto EXP_MIXER_C_POSITION = mm2px(Vec(38.0, 48.3));
+		auto EXP_ENV_POSITION = mm2px(Vec(38.0, 64.3));
+		auto EXP_VCO_SELECT_POSITION = mm2px(Vec(38.0, 80.3));
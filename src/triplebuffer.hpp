@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free handoff of the latest value from one writer thread to one reader
+// thread.  The writer fills write() and calls publish(); read() returns the
+// most recently published value.  Neither side ever waits or allocates.
+template <class T>
+struct TripleBuffer {
+	static const int FRESH = 4;
+
+	T slots[3] = {};
+	int writeIndex = 0;
+	int readIndex = 1;
+	// Index of the spare slot, with FRESH set while it holds unread data
+	std::atomic<int> middle {2};
+
+	T& write() {
+		return slots[writeIndex];
+	}
+
+	void publish() {
+		writeIndex = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & 3;
+	}
+
+	const T& read() {
+		if (middle.load(std::memory_order_relaxed) & FRESH)
+			readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & 3;
+		return slots[readIndex];
+	}
+};
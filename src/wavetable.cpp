@@ -0,0 +1,138 @@
+#include "wavetable.hpp"
+#include "sn76477.h"
+#include "rescap.h"
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+// The cycle is rendered this many samples long at this rate, fine enough for
+// the flip-flop edges to land within a fraction of a table sample
+static const int CYCLE = 16384;
+static const int CYCLE_RATE = 192000;
+
+void VcoWavetable::start() {
+	if (running)
+		return;
+	running = true;
+	worker = std::thread([this]() {
+		while (running) {
+			// Only one table can be in flight; the audio thread must pick it up
+			// first, and only then is the front index it leaves behind current
+			if (published.load(std::memory_order_acquire) < 0) {
+				int key = wanted.load(std::memory_order_relaxed);
+				int current = frontIndex.load(std::memory_order_acquire);
+				if (key >= 0 && key != tables[current].key) {
+					int back = 1 - current;
+					build(tables[back], key);
+					published.store(back, std::memory_order_release);
+					continue;
+				}
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	});
+}
+
+void VcoWavetable::stop() {
+	running = false;
+	if (worker.joinable())
+		worker.join();
+}
+
+int VcoWavetable::makeKey(double pitchVoltage, int engine) {
+	int duty = (int) round(pitchVoltage * 100);
+	duty = (duty < 0) ? 0 : (duty > 1000) ? 1000 : duty;
+	return duty * sn76477_device::ENGINES + engine;
+}
+
+void VcoWavetable::build(Table& t, int key) {
+	sn76477_device sn;
+	sn.set_amp_res(100);
+	sn.set_feedback_res(100);
+	sn.set_m_our_sample_rate(CYCLE_RATE);
+	sn.device_start();
+
+	sn.set_vco_params(2.30, 0, 1);
+	sn.set_slf_params(CAP_U(.047), 1);
+	sn.set_noise_params(10000, 1, CAP_P(470));
+	sn.set_decay_res(10000000);
+	sn.set_attack_params(0.00000005, 10);
+	sn.set_pitch_voltage((key / sn76477_device::ENGINES) / 100.0);
+	sn.set_mixer_params(1, 0, 0);
+	sn.set_envelope(2);
+	sn.set_vco_mode(0);
+	sn.set_oneshot_params(500e-9, 5000000);
+	sn.set_engine(key % sn76477_device::ENGINES);
+	sn.set_outputs_connected(1, 1);
+
+	// Frequency goes as 1 / vco_res, so scale it for exactly one cycle per CYCLE samples.
+	// A duty that stalls the VCO leaves a constant, which the tables then hold.
+	double f = sn.vco_frequency();
+	if (f > 0)
+		sn.set_vco_params(2.30, 0, f * CYCLE / CYCLE_RATE);
+
+	// Let the attack cap settle, then capture one cycle
+	std::vector<double> out(CYCLE), cap(CYCLE);
+	for (int i = 0; i < 2 * CYCLE; i++)
+		sn.sound_stream_update(1);
+	for (int i = 0; i < CYCLE; i++) {
+		Rsamples sam = sn.sound_stream_update(1);
+		out[i] = sam.s1;
+		cap[i] = sam.s2;
+	}
+
+	// Fourier series of the captured cycle, using a cosine table indexed mod CYCLE
+	std::vector<double> cosine(CYCLE);
+	for (int n = 0; n < CYCLE; n++)
+		cosine[n] = cos(2 * M_PI * n / CYCLE);
+
+	std::vector<double> coeff(4 * (HARMONICS + 1));
+	double* outA = &coeff[0];
+	double* outB = outA + HARMONICS + 1;
+	double* capA = outB + HARMONICS + 1;
+	double* capB = capA + HARMONICS + 1;
+
+	for (int h = 0; h <= HARMONICS; h++) {
+		double oa = 0, ob = 0, ca = 0, cb = 0;
+		for (int n = 0; n < CYCLE; n++) {
+			int i = (int) (((long) h * n) & (CYCLE - 1));
+			double c = cosine[i];
+			double s = cosine[(i + 3 * CYCLE / 4) & (CYCLE - 1)];
+			oa += out[n] * c;
+			ob += out[n] * s;
+			ca += cap[n] * c;
+			cb += cap[n] * s;
+		}
+		double scale = (h == 0) ? 1.0 / CYCLE : 2.0 / CYCLE;
+		outA[h] = oa * scale;
+		outB[h] = ob * scale;
+		capA[h] = ca * scale;
+		capB[h] = cb * scale;
+	}
+
+	// Build from the narrowest level up, each one adding the next band of harmonics
+	std::vector<double> outSum(SIZE, outA[0]), capSum(SIZE, capA[0]);
+	int done = 0;
+	for (int level = LEVELS - 1; level >= 0; level--) {
+		int top = HARMONICS >> level;
+		for (int h = done + 1; h <= top; h++) {
+			for (int m = 0; m < SIZE; m++) {
+				int i = (int) (((long) h * m * (CYCLE / SIZE)) & (CYCLE - 1));
+				double c = cosine[i];
+				double s = cosine[(i + 3 * CYCLE / 4) & (CYCLE - 1)];
+				outSum[m] += outA[h] * c + outB[h] * s;
+				capSum[m] += capA[h] * c + capB[h] * s;
+			}
+		}
+		done = top;
+
+		for (int m = 0; m < SIZE; m++) {
+			t.out[level][m] = (float) outSum[m];
+			t.cap[level][m] = (float) capSum[m];
+		}
+		t.out[level][SIZE] = t.out[level][0];
+		t.cap[level][SIZE] = t.cap[level][0];
+	}
+
+	t.key = key;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+// Band-limited wavetables of the chip's free-running VCO.
+//
+// With the SLF off and only the VCO on the mixer, OUT and the VCO cap voltage
+// are periodic and their shape depends only on the duty (pitch voltage) and
+// the cap model.  One cycle of each is rendered with a private sn76477_device
+// and stored as a mipmap, level k keeping the first HARMONICS >> k harmonics,
+// so any pitch can be played back without aliasing.
+//
+// Tables are built on a background thread into the back buffer and handed to
+// the audio thread through an atomic index; the audio thread never waits.
+struct VcoWavetable {
+	static const int SIZE = 4096;
+	static const int HARMONICS = 1024;
+	static const int LEVELS = 11;
+
+	struct Table {
+		int key = -1;
+		float out[LEVELS][SIZE + 1];
+		float cap[LEVELS][SIZE + 1];
+	};
+
+	Table tables[2];
+	int front = 0;
+	std::atomic<int> frontIndex {0};
+	std::atomic<int> published {-1};
+	std::atomic<int> wanted {-1};
+	std::atomic<bool> running {false};
+	std::thread worker;
+
+	~VcoWavetable() {
+		stop();
+	}
+
+	void start();
+	void stop();
+
+	// Duty is quantized to 10 mV so CV wobble doesn't keep the builder busy
+	static int makeKey(double pitchVoltage, int engine);
+
+	// Audio thread: asks for the table matching `key` and returns the newest
+	// finished one, which may still be for an older key.  Null until the
+	// first table is ready.
+	const Table* update(int key) {
+		int ready = published.load(std::memory_order_acquire);
+		if (ready >= 0) {
+			front = ready;
+			frontIndex.store(ready, std::memory_order_release);
+			published.store(-1, std::memory_order_release);
+		}
+		wanted.store(key, std::memory_order_relaxed);
+		return (tables[front].key >= 0) ? &tables[front] : nullptr;
+	}
+
+	// Reads both waves at `phase` (in cycles) from the widest level that has
+	// no harmonics above Nyquist for a phase increment of `inc` per sample
+	static void read(const Table& t, double phase, double inc, float& out, float& cap) {
+		int level = 0;
+		while (level < LEVELS - 1 && (HARMONICS >> level) * inc > 0.5)
+			level++;
+
+		double position = phase * SIZE;
+		int i = (int) position;
+		float frac = (float) (position - i);
+		const float* o = &t.out[level][i];
+		const float* c = &t.cap[level][i];
+		out = o[0] + frac * (o[1] - o[0]);
+		cap = c[0] + frac * (c[1] - c[0]);
+	}
+
+private:
+	static void build(Table& t, int key);
+};
@@ -27,30 +27,41 @@ Button18::Button18() {
 }
 
 StatefulButton::StatefulButton(const char* offSvgPath, const char* onSvgPath) {
+	// The art only changes when the button is pressed, so draw it through a
+	// framebuffer instead of rasterizing the SVG every frame
+	fb = new FramebufferWidget();
+	addChild(fb);
+
 	shadow = new CircularShadow();
-	addChild(shadow);
+	fb->addChild(shadow);
 
 	_svgWidget = new SvgWidget();
-	addChild(_svgWidget);
+	fb->addChild(_svgWidget);
 
+	// loadSvg() caches by path, so every button shares the same two Svgs
 	auto svg = APP->window->loadSvg(asset::plugin(pluginInstance, offSvgPath));
 	_frames.push_back(svg);
 	_frames.push_back(APP->window->loadSvg(asset::plugin(pluginInstance, onSvgPath)));
 
 	_svgWidget->setSvg(svg);
 	box.size = _svgWidget->box.size;
+	fb->box.size = _svgWidget->box.size;
 	shadow->box.size = _svgWidget->box.size;
 	shadow->blurRadius = 1.0;
 	shadow->box.pos = Vec(0.0, 1.0);
 }
 
+void StatefulButton::setFrame(int frame) {
+	_svgWidget->setSvg(_frames[frame]);
+	fb->setDirty();
+}
+
 void StatefulButton::onDragStart(const event::DragStart& e) {
 
     ParamQuantity* paramQuantity = getParamQuantity();
 
-	_svgWidget->setSvg(_frames[1]);
+	setFrame(1);
 	if (paramQuantity) {
-    _svgWidget->setSvg(_frames[1]);
     if (paramQuantity->getValue() >= paramQuantity->getMaxValue()) {
       paramQuantity->setValue(paramQuantity->getMinValue());
     }
@@ -61,7 +72,7 @@ void StatefulButton::onDragStart(const event::DragStart& e) {
 }
 
 void StatefulButton::onDragEnd(const event::DragEnd& e) {
-	_svgWidget->setSvg(_frames[0]);
+	setFrame(0);
 }
 
 StatefulButton18::StatefulButton18() : StatefulButton("res/button_18px_0.svg", "res/button_18px_1.svg") {
@@ -21,10 +21,12 @@ struct Snap_8M_Knob : RoundKnob {
 
 struct StatefulButton : ParamWidget {
 	std::vector<std::shared_ptr<Svg>> _frames;
+	FramebufferWidget* fb;
 	SvgWidget* _svgWidget; // deleted elsewhere.
 	CircularShadow* shadow = NULL;
 
 	StatefulButton(const char* offSvgPath, const char* onSvgPath);
+	void setFrame(int frame);
 	void onDragStart(const event::DragStart& e) override;
 	void onDragEnd(const event::DragEnd& e) override;
 };
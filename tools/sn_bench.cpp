@@ -0,0 +1,301 @@
+// Spectral quality versus CPU benchmark for the chip's engine options.
+//
+//   make sn_bench
+//   ./sn_bench [-rate 48000] [-seconds 2] [-os 1,2,4] [-substeps 2,3,6,12] [-block 0,64] [-md]
+//
+// Renders a set of test patches once per engine configuration (cap model,
+// oversampling factor, sub-step count and block size) and prints one row
+// per patch and configuration, as CSV or with -md as a markdown table.
+// Block sizes other than 0 render through sound_stream_update_block() with
+// the pins ramped across each block, like the module's low CPU mode, and
+// only without oversampling.
+//
+//   alias_db       error of the Welch power spectrum against a reference
+//                  rendered at REF_OVERSAMPLE x with the default sub-steps,
+//                  relative to the reference power.  Aliased partials that
+//                  fold back below Nyquist are what dominates it.
+//   dc             mean of OUT, full scale = 1
+//   ns_per_sample  wall time per output sample, decimation included
+//
+// Oversampled renders are decimated with the module's own polyphase resampler.
+
+#include "sn76477.h"
+#include "resampler.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+
+static const int REF_OVERSAMPLE = 16;
+static const int FFT_SIZE = 4096;
+
+
+struct Patch {
+	const char* name;
+	int mixer[3];
+	int vcoMode;
+	bool sweep;
+};
+
+// Mixer-only envelope everywhere, so OUT runs at a steady level
+static const Patch patches[] = {
+	{"vco_sweep", {1, 0, 0}, 0, true},
+	{"noise", {0, 0, 1}, 0, false},
+	{"vco_noise", {1, 0, 1}, 0, false},
+	{"slf_vco", {1, 0, 0}, 1, false},
+};
+
+struct Config {
+	int engine;
+	int oversample;
+	int subSteps;
+	int block;
+};
+
+
+static void setupChip(sn76477_device& sn, const Patch& patch, const Config& config, int chipRate) {
+	sn.set_amp_res(100);
+	sn.set_feedback_res(100);
+	sn.set_m_our_sample_rate(chipRate);
+	sn.set_sub_steps(config.subSteps);
+	sn.device_start();
+
+	sn.set_vco_params(2.30, 0, 1.752);
+	sn.set_slf_params(CAP_U(.047), 1.283184);
+	sn.set_noise_params(47000, 470000, CAP_P(470));
+	sn.set_decay_res(10000000);
+	sn.set_attack_params(0.00000005, 10);
+	sn.set_pitch_voltage(2.30);
+	sn.set_mixer_params(patch.mixer[0], patch.mixer[1], patch.mixer[2]);
+	sn.set_envelope(2);
+	sn.set_vco_mode(patch.vcoMode);
+	sn.set_oneshot_params(500e-9, 5000000);
+	sn.set_engine(config.engine);
+	sn.set_outputs_connected(1, 0);
+}
+
+
+// Renders `frames` output samples of OUT, returns the time taken in ns/sample
+static double render(const Patch& patch, const Config& config, int rate, int frames, std::vector<float>& out) {
+	int chipRate = rate * config.oversample;
+	sn76477_device sn;
+	setupChip(sn, patch, config, chipRate);
+
+	// The sweep goes from 100 Hz to 8 kHz exponentially, vco_res being inversely proportional to pitch
+	sn.set_vco_params(2.30, 0, 1);
+	double f1 = sn.vco_frequency();
+	double sweepStart = f1 / 100;
+	double sweepRatio = pow(100.0 / 8000, 1.0 / ((double) frames * config.oversample));
+	double vcoRes = sweepStart;
+	sn.set_vco_params(2.30, 0, patch.sweep ? vcoRes : 1.752);
+
+	PolyphaseResampler<1> decimator;
+	decimator.setRates(chipRate, rate);
+
+	out.resize(frames);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (config.block > 0) {
+		sn76477_controls from, to;
+		from.vco_res = vcoRes;
+		from.slf_res = 1.283184;
+		from.noise_clock_res = 47000;
+		from.noise_filter_res = 470000;
+		from.decay_res = 10000000;
+		from.attack_res = 10;
+		from.pitch_voltage = 2.30;
+		from.one_shot_cap = 500e-9;
+		if (!patch.sweep)
+			from.vco_res = 1.752;
+		to = from;
+
+		std::vector<Rsamples> block(config.block);
+		for (int i = 0; i < frames; i += config.block) {
+			int count = std::min(config.block, frames - i);
+			if (patch.sweep) {
+				vcoRes *= pow(sweepRatio, count);
+				to.vco_res = vcoRes;
+			}
+			sn.sound_stream_update_block(block.data(), count, from, to, nullptr);
+			for (int n = 0; n < count; n++)
+				out[i + n] = block[n].s1 / 32767.0;
+			from = to;
+		}
+	}
+
+	for (int i = 0; i < frames && config.block <= 0; i++) {
+		if (config.oversample == 1) {
+			if (patch.sweep) {
+				vcoRes *= sweepRatio;
+				sn.set_vco_params(2.30, 0, vcoRes);
+			}
+			out[i] = sn.sound_stream_update(1).s1 / 32767.0;
+			continue;
+		}
+		decimator.process([&](float* frame) {
+			if (patch.sweep) {
+				vcoRes *= sweepRatio;
+				sn.set_vco_params(2.30, 0, vcoRes);
+			}
+			frame[0] = sn.sound_stream_update(1).s1 / 32767.0;
+		}, &out[i]);
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return elapsed * 1e9 / frames;
+}
+
+
+static void fft(std::vector<std::complex<double>>& x) {
+	int n = x.size();
+	for (int i = 1, j = 0; i < n; i++) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(x[i], x[j]);
+	}
+	for (int len = 2; len <= n; len <<= 1) {
+		std::complex<double> w(cos(-2 * M_PI / len), sin(-2 * M_PI / len));
+		for (int i = 0; i < n; i += len) {
+			std::complex<double> wk(1, 0);
+			for (int k = 0; k < len / 2; k++) {
+				std::complex<double> a = x[i + k];
+				std::complex<double> b = x[i + k + len / 2] * wk;
+				x[i + k] = a + b;
+				x[i + k + len / 2] = a - b;
+				wk *= w;
+			}
+		}
+	}
+}
+
+
+// Welch power spectrum, Hann window with 50% overlap, DC removed per segment
+static void powerSpectrum(const std::vector<float>& in, std::vector<double>& power) {
+	power.assign(FFT_SIZE / 2 + 1, 0.0);
+	std::vector<std::complex<double>> buf(FFT_SIZE);
+
+	for (size_t start = 0; start + FFT_SIZE <= in.size(); start += FFT_SIZE / 2) {
+		double mean = 0;
+		for (int i = 0; i < FFT_SIZE; i++)
+			mean += in[start + i];
+		mean /= FFT_SIZE;
+
+		for (int i = 0; i < FFT_SIZE; i++) {
+			double window = 0.5 - 0.5 * cos(2 * M_PI * i / FFT_SIZE);
+			buf[i] = (in[start + i] - mean) * window;
+		}
+		fft(buf);
+		for (int k = 0; k <= FFT_SIZE / 2; k++)
+			power[k] += std::norm(buf[k]);
+	}
+}
+
+
+static std::vector<int> parseList(const char* s) {
+	std::vector<int> list;
+	while (*s) {
+		list.push_back(atoi(s));
+		const char* comma = strchr(s, ',');
+		if (!comma)
+			break;
+		s = comma + 1;
+	}
+	return list;
+}
+
+
+int main(int argc, char** argv) {
+	int rate = 48000;
+	double seconds = 2.0;
+	std::vector<int> oversamples = {1, 2, 4};
+	std::vector<int> subSteps = {2, 3, 6, 12};
+	std::vector<int> blocks = {0, 64};
+	bool markdown = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-rate") && i + 1 < argc)
+			rate = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-seconds") && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-os") && i + 1 < argc)
+			oversamples = parseList(argv[++i]);
+		else if (!strcmp(argv[i], "-substeps") && i + 1 < argc)
+			subSteps = parseList(argv[++i]);
+		else if (!strcmp(argv[i], "-block") && i + 1 < argc)
+			blocks = parseList(argv[++i]);
+		else if (!strcmp(argv[i], "-md"))
+			markdown = true;
+		else {
+			fprintf(stderr, "usage: %s [-rate hz] [-seconds s] [-os 1,2,4] [-substeps 2,3,6,12] [-block 0,64] [-md]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int frames = (int) (rate * seconds);
+	if (frames < FFT_SIZE) {
+		fprintf(stderr, "sn_bench: need at least %d samples\n", FFT_SIZE);
+		return 1;
+	}
+
+	sn76477_device::select_kernel(sn76477_device::best_kernel());
+	fprintf(stderr, "sn_bench: %d Hz, %.2f s, %s kernel\n", rate, seconds,
+		sn76477_device::kernel_name(sn76477_device::selected_kernel()));
+
+	static const char* engineNames[] = {"linear", "analog", "fixed"};
+	if (markdown) {
+		printf("| patch | engine | oversample | substeps | block | alias_db | dc | ns_per_sample |\n");
+		printf("|---|---|---:|---:|---:|---:|---:|---:|\n");
+	}
+	else {
+		printf("patch,engine,oversample,substeps,block,alias_db,dc,ns_per_sample\n");
+	}
+
+	std::vector<float> out;
+	std::vector<double> reference, power;
+
+	for (const Patch& patch : patches) {
+		for (int engine = sn76477_device::ENGINE_LINEAR; engine <= sn76477_device::ENGINE_FIXED; engine++) {
+			Config refConfig = {engine, REF_OVERSAMPLE, sn76477_device::SUB_STEPS, 0};
+			render(patch, refConfig, rate, frames, out);
+			powerSpectrum(out, reference);
+
+			double referencePower = 0;
+			for (double p : reference)
+				referencePower += p;
+
+			for (int os : oversamples) {
+				for (int steps : subSteps) {
+					for (int block : blocks) {
+						if (block > 0 && os != 1)
+							continue;
+						Config config = {engine, os, steps, block};
+						double ns = render(patch, config, rate, frames, out);
+						powerSpectrum(out, power);
+
+						double error = 0;
+						for (size_t k = 0; k < power.size(); k++)
+							error += fabs(power[k] - reference[k]);
+						double aliasDb = 10 * log10(error / referencePower + 1e-30);
+
+						double dc = 0;
+						for (float v : out)
+							dc += v;
+						dc /= out.size();
+
+						const char* format = markdown ? "| %s | %s | %d | %d | %d | %.1f | %.5f | %.1f |\n" : "%s,%s,%d,%d,%d,%.1f,%.5f,%.1f\n";
+						printf(format, patch.name, engineNames[engine], os, steps, block, aliasDb, dc, ns);
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
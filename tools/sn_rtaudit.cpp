@@ -0,0 +1,148 @@
+// Realtime-safety check of the chip's audio path.
+//
+//   make sn_rtaudit
+//   ./sn_rtaudit [-rate 48000] [-samples 4800]
+//
+// Renders every cap model, mixer, envelope and VCO mode combination with
+// every supported kernel, sample by sample through sound_stream_update() and
+// in blocks through sound_stream_update_block(), with one-shot triggers and
+// pin changes along the way.  Everything after the chip is set up runs in an
+// RT_AUDIT_SCOPE(), and any heap allocation, free or mutex lock it makes is
+// counted (see src/rtaudit.hpp).
+//
+// Prints the combinations that did any, and exits with 1 if there was one,
+// so it can run unattended after changes to the engine.
+
+#include "sn76477.h"
+#include "rtaudit.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef SOFTSN_RT_AUDIT
+#error "sn_rtaudit needs the audit compiled in, build it with `make sn_rtaudit`"
+#endif
+
+
+static const int BLOCK = 64;
+
+static void setDefaults(sn76477_device& sn, int rate) {
+	sn.set_amp_res(100);
+	sn.set_feedback_res(100);
+	sn.set_m_our_sample_rate(rate);
+	sn.device_start();
+	sn.set_vco_params(2.30, 0, 1.752);
+	sn.set_slf_params(CAP_U(.047), 1.283184);
+	sn.set_noise_params(10000, 1, CAP_P(470));
+	sn.set_decay_res(10000000);
+	sn.set_attack_params(0.00000005, 10);
+	sn.set_pitch_voltage(2.30);
+	sn.set_oneshot_params(500e-9, 5000000);
+	sn.set_outputs_connected(1, 1);
+}
+
+static void setControls(sn76477_controls& c, double scale) {
+	c.vco_res = 1.752 * scale;
+	c.slf_res = 1.283184 * scale;
+	c.noise_clock_res = 10000 * scale;
+	c.noise_filter_res = 1;
+	c.decay_res = 1000000 * scale;
+	c.attack_res = 10000 * scale;
+	c.pitch_voltage = 2.30;
+	c.one_shot_cap = 500e-9 * scale;
+}
+
+// Renders one combination inside the audit scope, returns what it counted
+static rtaudit::Counts audit(int rate, int samples, int engine, int mixer, int envelope, int vcoMode) {
+	sn76477_device sn;
+	setDefaults(sn, rate);
+	sn.set_engine(engine);
+	sn.set_mixer_params(mixer & 1, (mixer >> 1) & 1, (mixer >> 2) & 1);
+	sn.set_envelope(envelope);
+	sn.set_vco_mode(vcoMode);
+
+	sn76477_controls from, to;
+	setControls(from, 1);
+	setControls(to, 2);
+	Rsamples block[BLOCK];
+	float triggers[BLOCK];
+	for (int i = 0; i < BLOCK; i++)
+		triggers[i] = (i == BLOCK / 2) ? 0.25f : -1.f;
+
+	rtaudit::reset();
+	{
+		RT_AUDIT_SCOPE();
+
+		for (int i = 0; i < samples; i++) {
+			if (i % (samples / 4 + 1) == 0)
+				sn.shot_trigger();
+			if (i == samples / 2) {
+				// Every section is recomputed on the next sample
+				sn.set_vco_params(2.30, 0, 3.1);
+				sn.set_slf_params(CAP_U(.047), 0.7);
+				sn.set_noise_params(47000, 470000, CAP_P(470));
+				sn.set_attack_params(0.00000005, 10000);
+				sn.set_decay_res(1000000);
+				sn.set_oneshot_params(100e-9, 5000000);
+				sn.set_amp_res(220);
+			}
+			sn.sound_stream_update(1);
+		}
+
+		for (int done = 0; done < samples; done += BLOCK) {
+			bool up = (done / BLOCK) & 1;
+			sn.sound_stream_update_block(block, BLOCK, up ? from : to, up ? to : from, triggers);
+		}
+	}
+	return rtaudit::counts();
+}
+
+int main(int argc, char** argv) {
+	int rate = 48000;
+	int samples = 4800;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-rate") && i + 1 < argc)
+			rate = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-samples") && i + 1 < argc)
+			samples = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-rate hz] [-samples n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (samples <= 0 || rate <= 0) {
+		fprintf(stderr, "sn_rtaudit: need a rate and at least one sample\n");
+		return 1;
+	}
+
+	static const char* engineNames[] = {"linear", "analog", "fixed"};
+	int cases = 0;
+	int failures = 0;
+
+	for (int kernel = 0; kernel < sn76477_device::KERNEL_COUNT; kernel++) {
+		if (!sn76477_device::kernel_supported(kernel))
+			continue;
+		sn76477_device::select_kernel(kernel);
+
+		for (int engine = sn76477_device::ENGINE_LINEAR; engine <= sn76477_device::ENGINE_FIXED; engine++) {
+			for (int mixer = 0; mixer < 8; mixer++) {
+				for (int envelope = 0; envelope < 4; envelope++) {
+					for (int vcoMode = 0; vcoMode < 2; vcoMode++) {
+						rtaudit::Counts c = audit(rate, samples, engine, mixer, envelope, vcoMode);
+						cases++;
+						if (c.total()) {
+							printf("%s kernel, %s engine, mixer %d, envelope %d, vco mode %d: %llu allocs, %llu frees, %llu locks\n",
+								sn76477_device::kernel_name(kernel), engineNames[engine], mixer, envelope, vcoMode,
+								(unsigned long long) c.allocs, (unsigned long long) c.frees, (unsigned long long) c.locks);
+							failures++;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	fprintf(stderr, "sn_rtaudit: %d of %d combinations allocated or locked on the audio path\n", failures, cases);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,334 @@
+// Long-form streaming renderer with checkpoint and resume.
+//
+//   make sn_stream
+//   ./sn_stream patch.txt out.wav [-resume]
+//
+// The patch file uses sn_sweep's settings, with fixed values only:
+//
+//   rate 48000                  sample rate of the render
+//   seconds 3600                length of the render
+//   mixer 1 0 1                 mixer A/B/C
+//   envelope 0                  0 = VCO, 1 = one-shot, 2 = mixer only, 3 = VCO alt
+//   vco_mode 1                  0 = external voltage, 1 = SLF
+//   trigger 1                   fire the one-shot at the start
+//   engine 1                    0 = linear caps, 1 = analog caps, 2 = fixed point
+//   checkpoint 10               seconds between checkpoints
+//   <param> <value>             vco_res, slf_res, noise_clock_res, noise_filter_res,
+//                               decay_res, attack_res, duty or one_shot_cap
+//
+// The output is a 32-bit float WAV sized up front and written through a
+// memory-mapped window that slides along the file, so memory use does not grow
+// with the length.  After each window is flushed to disk the chip state is
+// saved to out.wav.ckpt.  With -resume the render picks up from that
+// checkpoint and continues bit-exactly, as if it had never stopped.
+
+#include "sn76477.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+enum PatchParam {
+	VCO_RES,
+	SLF_RES,
+	NOISE_CLOCK_RES,
+	NOISE_FILTER_RES,
+	DECAY_RES,
+	ATTACK_RES,
+	DUTY,
+	ONE_SHOT_CAP,
+	NUM_PATCH_PARAMS
+};
+
+static const char* paramNames[NUM_PATCH_PARAMS] = {
+	"vco_res", "slf_res", "noise_clock_res", "noise_filter_res", "decay_res", "attack_res", "duty", "one_shot_cap"
+};
+
+// Module defaults, so an empty patch file renders the default patch
+static const double paramDefaults[NUM_PATCH_PARAMS] = {
+	1.752, 1.283184, 10000, 1, 10000000, 10, 2.30, 500e-9
+};
+
+struct Patch {
+	int sampleRate = 48000;
+	double seconds = 60.0;
+	int mixer[3] = {1, 0, 0};
+	int envelope = 0;
+	int vcoMode = 0;
+	bool trigger = false;
+	int engine = sn76477_device::ENGINE_LINEAR;
+	double checkpointSeconds = 10.0;
+	double values[NUM_PATCH_PARAMS];
+
+	Patch() {
+		memcpy(values, paramDefaults, sizeof(values));
+	}
+};
+
+static const uint32_t HEADER_SIZE = 44;
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+// Written next to the WAV after every flushed window
+struct Checkpoint {
+	char magic[4];               // "SNCK"
+	uint32_t version;
+	uint32_t kernel;
+	uint32_t pad;
+	uint64_t frames;             // frames rendered and flushed so far
+	uint64_t totalFrames;
+	sn76477_pins pins;           // to refuse resuming with a different patch
+	sn76477_state state;
+};
+
+
+static bool parsePatch(const char* path, Patch& patch) {
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "sn_stream: cannot open %s\n", path);
+		return false;
+	}
+
+	char line[256];
+	int lineNo = 0;
+	bool ok = true;
+
+	while (fgets(line, sizeof(line), f)) {
+		lineNo++;
+		char* comment = strchr(line, '#');
+		if (comment)
+			*comment = 0;
+
+		char key[64];
+		double v[3];
+		int n = sscanf(line, "%63s %lf %lf %lf", key, &v[0], &v[1], &v[2]);
+		if (n <= 0)
+			continue;
+
+		int p = 0;
+		while (p < NUM_PATCH_PARAMS && strcmp(key, paramNames[p]))
+			p++;
+
+		if (p < NUM_PATCH_PARAMS && n == 2)
+			patch.values[p] = v[0];
+		else if (!strcmp(key, "rate") && n == 2)
+			patch.sampleRate = (int) v[0];
+		else if (!strcmp(key, "seconds") && n == 2)
+			patch.seconds = v[0];
+		else if (!strcmp(key, "mixer") && n == 4)
+			patch.mixer[0] = (int) v[0], patch.mixer[1] = (int) v[1], patch.mixer[2] = (int) v[2];
+		else if (!strcmp(key, "envelope") && n == 2)
+			patch.envelope = (int) v[0];
+		else if (!strcmp(key, "vco_mode") && n == 2)
+			patch.vcoMode = (int) v[0];
+		else if (!strcmp(key, "trigger") && n == 2)
+			patch.trigger = (v[0] != 0);
+		else if (!strcmp(key, "engine") && n == 2)
+			patch.engine = (int) v[0];
+		else if (!strcmp(key, "checkpoint") && n == 2 && v[0] > 0)
+			patch.checkpointSeconds = v[0];
+		else {
+			fprintf(stderr, "sn_stream: %s:%d: cannot parse '%s'\n", path, lineNo, key);
+			ok = false;
+		}
+	}
+
+	fclose(f);
+	return ok;
+}
+
+
+static void setupChip(sn76477_device& sn, const Patch& patch) {
+	sn.set_amp_res(100);
+	sn.set_feedback_res(100);
+	sn.set_m_our_sample_rate(patch.sampleRate);
+	sn.device_start();
+
+	sn.set_vco_params(2.30, 0, patch.values[VCO_RES]);
+	sn.set_slf_params(CAP_U(.047), patch.values[SLF_RES]);
+	sn.set_noise_params(patch.values[NOISE_CLOCK_RES], patch.values[NOISE_FILTER_RES], CAP_P(470));
+	sn.set_decay_res(patch.values[DECAY_RES]);
+	sn.set_attack_params(0.00000005, patch.values[ATTACK_RES]);
+	sn.set_pitch_voltage(patch.values[DUTY]);
+	sn.set_mixer_params(patch.mixer[0], patch.mixer[1], patch.mixer[2]);
+	sn.set_envelope(patch.envelope);
+	sn.set_vco_mode(patch.vcoMode);
+	sn.set_oneshot_params(patch.values[ONE_SHOT_CAP], 5000000);
+	sn.set_engine(patch.engine);
+}
+
+
+static void writeHeader(uint8_t* p, uint64_t frames, int sampleRate) {
+	uint32_t dataSize = frames * sizeof(float);
+	uint32_t riffSize = 36 + dataSize;
+	uint32_t fmtSize = 16;
+	uint16_t format = 3;  // IEEE float
+	uint16_t channels = 1;
+	uint32_t rate = sampleRate;
+	uint32_t byteRate = sampleRate * sizeof(float);
+	uint16_t blockAlign = sizeof(float);
+	uint16_t bits = 32;
+
+	memcpy(p + 0, "RIFF", 4);
+	memcpy(p + 4, &riffSize, 4);
+	memcpy(p + 8, "WAVEfmt ", 8);
+	memcpy(p + 16, &fmtSize, 4);
+	memcpy(p + 20, &format, 2);
+	memcpy(p + 22, &channels, 2);
+	memcpy(p + 24, &rate, 4);
+	memcpy(p + 28, &byteRate, 4);
+	memcpy(p + 32, &blockAlign, 2);
+	memcpy(p + 34, &bits, 2);
+	memcpy(p + 36, "data", 4);
+	memcpy(p + 40, &dataSize, 4);
+}
+
+
+// Writes to a temporary file and renames it over the old checkpoint, so a
+// crash leaves either the old or the new one
+static bool saveCheckpoint(const std::string& path, const Checkpoint& checkpoint) {
+	std::string tmp = path + ".tmp";
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+	bool ok = write(fd, &checkpoint, sizeof(checkpoint)) == (ssize_t) sizeof(checkpoint) && fsync(fd) == 0;
+	close(fd);
+	return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+static bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint) {
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	bool ok = fread(&checkpoint, sizeof(checkpoint), 1, f) == 1;
+	fclose(f);
+	return ok && !memcmp(checkpoint.magic, "SNCK", 4) && checkpoint.version == CHECKPOINT_VERSION;
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 3 || (argc > 3 && strcmp(argv[3], "-resume"))) {
+		fprintf(stderr, "usage: %s <patch file> <out.wav> [-resume]\n", argv[0]);
+		return 1;
+	}
+	bool resume = (argc > 3);
+	std::string outPath = argv[2];
+	std::string checkpointPath = outPath + ".ckpt";
+
+	Patch patch;
+	if (!parsePatch(argv[1], patch))
+		return 1;
+
+	uint64_t totalFrames = (uint64_t) (patch.seconds * patch.sampleRate);
+	if (totalFrames == 0 || totalFrames * sizeof(float) > 0xffffffffull - HEADER_SIZE) {
+		fprintf(stderr, "sn_stream: %.0f s at %d Hz does not fit in a WAV file\n", patch.seconds, patch.sampleRate);
+		return 1;
+	}
+
+	sn76477_device sn;
+	setupChip(sn, patch);
+
+	Checkpoint checkpoint = {};
+	memcpy(checkpoint.magic, "SNCK", 4);
+	checkpoint.version = CHECKPOINT_VERSION;
+	checkpoint.kernel = sn76477_device::best_kernel();
+	checkpoint.totalFrames = totalFrames;
+	sn.get_pins(checkpoint.pins);
+
+	uint64_t frames = 0;
+	if (resume) {
+		Checkpoint saved;
+		if (!loadCheckpoint(checkpointPath, saved)) {
+			fprintf(stderr, "sn_stream: no usable checkpoint at %s\n", checkpointPath.c_str());
+			return 1;
+		}
+		if (memcmp(&saved.pins, &checkpoint.pins, sizeof(sn76477_pins)) || saved.totalFrames != totalFrames) {
+			fprintf(stderr, "sn_stream: %s was made with a different patch\n", checkpointPath.c_str());
+			return 1;
+		}
+		// Kernels may round differently, so stay on the one the render started with
+		if (!sn76477_device::kernel_supported(saved.kernel)) {
+			fprintf(stderr, "sn_stream: the %s kernel of this checkpoint is not supported here\n",
+				sn76477_device::kernel_name(saved.kernel));
+			return 1;
+		}
+		checkpoint.kernel = saved.kernel;
+		frames = saved.frames;
+		sn.set_state(saved.state);
+	}
+	else if (patch.trigger) {
+		sn.shot_trigger();
+	}
+	sn76477_device::select_kernel(checkpoint.kernel);
+
+	int fd = open(outPath.c_str(), resume ? O_RDWR : (O_RDWR | O_CREAT | O_TRUNC), 0644);
+	if (fd < 0) {
+		fprintf(stderr, "sn_stream: cannot open %s\n", outPath.c_str());
+		return 1;
+	}
+	off_t fileSize = HEADER_SIZE + totalFrames * sizeof(float);
+	if (ftruncate(fd, fileSize) != 0) {
+		fprintf(stderr, "sn_stream: cannot size %s\n", outPath.c_str());
+		close(fd);
+		return 1;
+	}
+
+	// Windows are whole pages, so each one starts on a page boundary of the file
+	long pageSize = sysconf(_SC_PAGESIZE);
+	size_t windowBytes = (size_t) pageSize * ((patch.checkpointSeconds * patch.sampleRate * sizeof(float)) / pageSize + 1);
+
+	fprintf(stderr, "sn_stream: %s %llu of %llu frames, %s kernel\n", resume ? "resuming at" : "starting at",
+		(unsigned long long) frames, (unsigned long long) totalFrames, sn76477_device::kernel_name(checkpoint.kernel));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint64_t startFrames = frames;
+
+	while (frames < totalFrames) {
+		off_t byte = HEADER_SIZE + frames * sizeof(float);
+		off_t windowStart = byte - byte % pageSize;
+		size_t length = std::min((off_t) windowBytes, fileSize - windowStart);
+
+		uint8_t* window = (uint8_t*) mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, windowStart);
+		if (window == MAP_FAILED) {
+			fprintf(stderr, "sn_stream: cannot map %s\n", outPath.c_str());
+			close(fd);
+			return 1;
+		}
+
+		if (windowStart == 0)
+			writeHeader(window, totalFrames, patch.sampleRate);
+
+		// Output is scaled like the module's SQR output; memcpy as the header leaves floats unaligned
+		uint8_t* end = window + length;
+		for (uint8_t* p = window + (byte - windowStart); p + sizeof(float) <= end && frames < totalFrames; p += sizeof(float)) {
+			Rsamples sam = sn.sound_stream_update(1);
+			float out = (5.0 * sam.s1 / 25000) + 1.3;
+			memcpy(p, &out, sizeof(out));
+			frames++;
+		}
+
+		bool flushed = msync(window, length, MS_SYNC) == 0;
+		munmap(window, length);
+
+		// Only point the checkpoint at samples that are on disk
+		checkpoint.frames = frames;
+		sn.get_state(checkpoint.state);
+		if (!flushed || !saveCheckpoint(checkpointPath, checkpoint)) {
+			fprintf(stderr, "sn_stream: cannot checkpoint at frame %llu\n", (unsigned long long) frames);
+			close(fd);
+			return 1;
+		}
+	}
+
+	close(fd);
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double rendered = (double) (frames - startFrames) / patch.sampleRate;
+	fprintf(stderr, "sn_stream: rendered %.1f s in %.2f s (%.1fx realtime)\n", rendered, elapsed,
+		elapsed > 0 ? rendered / elapsed : 0.0);
+	return 0;
+}
@@ -0,0 +1,251 @@
+// Stress test of the chip emulation at extreme pin values.
+//
+//   make sn_stress
+//   ./sn_stress [-rate 48000] [-samples 20000] [-limit 4] [-md]
+//
+// Sets one pin at a time to an extreme value: zero, negative, tiny, huge,
+// infinite and NaN, and 100% duty on the pitch voltage.  Each value is
+// tried with every cap model, with everything on the mixer in one-shot mode
+// and with the VCO swept by the SLF.  Prints one row per case, as CSV or
+// with -md as a markdown table:
+//
+//   ns_per_sample  wall time per sample at the extreme value
+//   ratio          ns_per_sample against the default patch, a denormal
+//                  slow path or a per-sample recompute shows up here
+//   bad            samples with a non-finite output, or chip state left
+//                  non-finite or subnormal, counted at the extreme value
+//                  and again after going back to the default
+//
+// Exits with 1 if any case has bad samples or a ratio above -limit, so it
+// can run unattended after changes to the engine.
+
+#include "sn76477.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+
+enum StressPin {
+	VCO_RES,
+	VCO_VOLTAGE,
+	PITCH_VOLTAGE,
+	SLF_RES,
+	SLF_CAP,
+	NOISE_CLOCK_RES,
+	NOISE_FILTER_RES,
+	NOISE_FILTER_CAP,
+	ATTACK_RES,
+	DECAY_RES,
+	AD_CAP,
+	ONE_SHOT_RES,
+	ONE_SHOT_CAP,
+	AMP_RES,
+	FEEDBACK_RES,
+	NUM_STRESS_PINS
+};
+
+static const char* pinNames[NUM_STRESS_PINS] = {
+	"vco_res", "vco_voltage", "pitch_voltage", "slf_res", "slf_cap", "noise_clock_res", "noise_filter_res",
+	"noise_filter_cap", "attack_res", "decay_res", "ad_cap", "one_shot_res", "one_shot_cap", "amp_res", "feedback_res"
+};
+
+// The softSN defaults
+static const double pinDefaults[NUM_STRESS_PINS] = {
+	1.752, 0, 2.30, 1.283184, CAP_U(.047), 10000, 1, CAP_P(470), 10, 10000000, 0.00000005, 5000000, 500e-9, 100, 100
+};
+
+// The duty cycle is the pitch voltage against the VCO voltage, and stays at
+// 50% while the VCO voltage is 0V, so the pitch cases run with this one
+static const double DUTY_VCO_VOLTAGE = 1;
+
+struct Extreme {
+	const char* name;
+	double value;
+};
+
+static const Extreme extremes[] = {
+	{"zero", 0},
+	{"negative", -1},
+	{"tiny", 1e-300},
+	{"small", 1e-30},
+	{"huge", 1e+30},
+	{"max", std::numeric_limits<double>::max()},
+	{"inf", std::numeric_limits<double>::infinity()},
+	{"nan", std::numeric_limits<double>::quiet_NaN()},
+};
+
+struct Patch {
+	const char* name;
+	int mixer[3];
+	int envelope;
+	int vcoMode;
+};
+
+static const Patch patches[] = {
+	{"all_oneshot", {1, 1, 1}, 1, 0},
+	{"slf_vco", {1, 0, 0}, 2, 1},
+};
+
+
+static void setPins(sn76477_device& sn, const double* pins) {
+	sn.set_vco_params(pins[VCO_VOLTAGE], 0, pins[VCO_RES]);
+	sn.set_pitch_voltage(pins[PITCH_VOLTAGE]);
+	sn.set_slf_params(pins[SLF_CAP], pins[SLF_RES]);
+	sn.set_noise_params(pins[NOISE_CLOCK_RES], pins[NOISE_FILTER_RES], pins[NOISE_FILTER_CAP]);
+	sn.set_attack_params(pins[AD_CAP], pins[ATTACK_RES]);
+	sn.set_decay_res(pins[DECAY_RES]);
+	sn.set_oneshot_params(pins[ONE_SHOT_CAP], pins[ONE_SHOT_RES]);
+	sn.set_amp_res(pins[AMP_RES]);
+	sn.set_feedback_res(pins[FEEDBACK_RES]);
+}
+
+
+static void setupChip(sn76477_device& sn, const Patch& patch, int engine, int rate) {
+	sn.set_amp_res(100);
+	sn.set_feedback_res(100);
+	sn.set_m_our_sample_rate(rate);
+	sn.device_start();
+	setPins(sn, pinDefaults);
+	sn.set_mixer_params(patch.mixer[0], patch.mixer[1], patch.mixer[2]);
+	sn.set_envelope(patch.envelope);
+	sn.set_vco_mode(patch.vcoMode);
+	sn.set_engine(engine);
+	sn.set_outputs_connected(1, 1);
+}
+
+
+static bool badValue(double v) {
+	return !std::isfinite(v) || (v != 0 && fabs(v) < std::numeric_limits<double>::min());
+}
+
+static bool badState(const sn76477_state& s) {
+	return badValue(s.one_shot_cap_voltage) || badValue(s.slf_cap_voltage) || badValue(s.vco_cap_voltage) ||
+		badValue(s.noise_filter_cap_voltage) || badValue(s.attack_decay_cap_voltage);
+}
+
+
+// Renders `samples` samples with the pins set every sample, like the module
+// does, retriggering the one-shot now and then.  Returns ns/sample and adds
+// the bad samples to `bad`.
+static double render(sn76477_device& sn, const double* pins, int samples, int& bad) {
+	sn76477_state state;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < samples; i++) {
+		setPins(sn, pins);
+		if (i % 4096 == 0)
+			sn.shot_trigger();
+		Rsamples out = sn.sound_stream_update(1);
+		if (!std::isfinite(out.s1) || !std::isfinite(out.s2))
+			bad++;
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	sn.get_state(state);
+	if (badState(state))
+		bad++;
+	return elapsed * 1e9 / samples;
+}
+
+
+int main(int argc, char** argv) {
+	int rate = 48000;
+	int samples = 20000;
+	double limit = 4;
+	bool markdown = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-rate") && i + 1 < argc)
+			rate = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-samples") && i + 1 < argc)
+			samples = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-limit") && i + 1 < argc)
+			limit = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-md"))
+			markdown = true;
+		else {
+			fprintf(stderr, "usage: %s [-rate hz] [-samples n] [-limit ratio] [-md]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (samples <= 0) {
+		fprintf(stderr, "sn_stress: need at least one sample\n");
+		return 1;
+	}
+
+	sn76477_device::select_kernel(sn76477_device::best_kernel());
+	fprintf(stderr, "sn_stress: %d Hz, %d samples per case, %s kernel\n", rate, samples,
+		sn76477_device::kernel_name(sn76477_device::selected_kernel()));
+
+	static const char* engineNames[] = {"linear", "analog", "fixed"};
+	if (markdown) {
+		printf("| patch | engine | pin | value | ns_per_sample | ratio | bad |\n");
+		printf("|---|---|---|---|---:|---:|---:|\n");
+	}
+	else {
+		printf("patch,engine,pin,value,ns_per_sample,ratio,bad\n");
+	}
+
+	// The pitch voltage also gets 100% duty, twice the VCO voltage or more
+	std::vector<Extreme> pitchExtremes(std::begin(extremes), std::end(extremes));
+	pitchExtremes.push_back({"duty_100", 2 * DUTY_VCO_VOLTAGE});
+
+	int failures = 0;
+	double worst = 0;
+
+	for (const Patch& patch : patches) {
+		for (int engine = sn76477_device::ENGINE_LINEAR; engine <= sn76477_device::ENGINE_FIXED; engine++) {
+			// Median of a few runs, the first one warms the caches up
+			std::vector<double> runs;
+			for (int r = 0; r < 5; r++) {
+				sn76477_device sn;
+				setupChip(sn, patch, engine, rate);
+				int bad = 0;
+				runs.push_back(render(sn, pinDefaults, samples, bad));
+			}
+			std::sort(runs.begin(), runs.end());
+			double baseline = runs[runs.size() / 2];
+
+			for (int pin = 0; pin < NUM_STRESS_PINS; pin++) {
+				const std::vector<Extreme>& values = (pin == PITCH_VOLTAGE) ? pitchExtremes :
+					std::vector<Extreme>(std::begin(extremes), std::end(extremes));
+
+				for (const Extreme& extreme : values) {
+					double pins[NUM_STRESS_PINS];
+					memcpy(pins, pinDefaults, sizeof(pins));
+
+					sn76477_device sn;
+					setupChip(sn, patch, engine, rate);
+					int bad = 0;
+					render(sn, pins, samples / 4, bad);
+
+					pins[pin] = extreme.value;
+					if (pin == PITCH_VOLTAGE)
+						pins[VCO_VOLTAGE] = DUTY_VCO_VOLTAGE;
+					double ns = render(sn, pins, samples, bad);
+
+					// Going back to the default has to bring the chip back too
+					memcpy(pins, pinDefaults, sizeof(pins));
+					render(sn, pins, samples / 4, bad);
+
+					double ratio = ns / baseline;
+					worst = std::max(worst, ratio);
+					if (bad || ratio > limit)
+						failures++;
+
+					const char* format = markdown ? "| %s | %s | %s | %s | %.1f | %.2f | %d |\n" : "%s,%s,%s,%s,%.1f,%.2f,%d\n";
+					printf(format, patch.name, engineNames[engine], pinNames[pin], extreme.name, ns, ratio, bad);
+				}
+			}
+		}
+	}
+
+	fprintf(stderr, "sn_stress: %d failing cases, worst cost %.2fx the default patch\n", failures, worst);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,332 @@
+// Headless parameter-sweep renderer for building SFX libraries.
+//
+//   make sn_sweep
+//   ./sn_sweep sweep.txt out/ [-j threads]
+//
+// The sweep file has one setting per line, '#' starts a comment:
+//
+//   rate 48000                  sample rate of the rendered files
+//   seconds 2.0                 length of every point
+//   mixer 1 0 1                 mixer A/B/C
+//   envelope 1                  0 = VCO, 1 = one-shot, 2 = mixer only, 3 = VCO alt
+//   vco_mode 0                  0 = external voltage, 1 = SLF
+//   trigger 1                   fire the one-shot at the start of every point
+//   <param> <value>             fixed value
+//   <param> <start> <stop> <n>  n points from start to stop, swept as a grid
+//
+// where <param> is one of vco_res, slf_res, noise_clock_res, noise_filter_res,
+// decay_res, attack_res, duty or one_shot_cap, in the chip's own units.  Every
+// grid point is rendered by its own sn76477_device on a work-stealing thread
+// pool and written to out/point_NNNNNN.wav, with out/index.csv listing the
+// parameter values of each file.
+
+#include "sn76477.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+
+enum SweepParam {
+	VCO_RES,
+	SLF_RES,
+	NOISE_CLOCK_RES,
+	NOISE_FILTER_RES,
+	DECAY_RES,
+	ATTACK_RES,
+	DUTY,
+	ONE_SHOT_CAP,
+	NUM_SWEEP_PARAMS
+};
+
+static const char* paramNames[NUM_SWEEP_PARAMS] = {
+	"vco_res", "slf_res", "noise_clock_res", "noise_filter_res", "decay_res", "attack_res", "duty", "one_shot_cap"
+};
+
+// Module defaults, so an empty sweep file renders the default patch
+static const double paramDefaults[NUM_SWEEP_PARAMS] = {
+	1.752, 1.283184, 10000, 1, 10000000, 10, 2.30, 500e-9
+};
+
+struct Axis {
+	double start;
+	double stop;
+	int points;
+
+	double value(int i) const {
+		return (points > 1) ? start + (stop - start) * i / (points - 1) : start;
+	}
+};
+
+struct Sweep {
+	int sampleRate = 48000;
+	double seconds = 1.0;
+	int mixer[3] = {1, 0, 0};
+	int envelope = 0;
+	int vcoMode = 0;
+	bool trigger = false;
+	Axis axes[NUM_SWEEP_PARAMS];
+
+	Sweep() {
+		for (int p = 0; p < NUM_SWEEP_PARAMS; p++)
+			axes[p] = {paramDefaults[p], paramDefaults[p], 1};
+	}
+
+	long numPoints() const {
+		long n = 1;
+		for (int p = 0; p < NUM_SWEEP_PARAMS; p++)
+			n *= axes[p].points;
+		return n;
+	}
+
+	// Decode a flat point index into one value per parameter, first axis fastest
+	void pointValues(long index, double* values) const {
+		for (int p = 0; p < NUM_SWEEP_PARAMS; p++) {
+			values[p] = axes[p].value(index % axes[p].points);
+			index /= axes[p].points;
+		}
+	}
+};
+
+
+static bool parseSweep(const char* path, Sweep& sweep) {
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "sn_sweep: cannot open %s\n", path);
+		return false;
+	}
+
+	char line[256];
+	int lineNo = 0;
+	bool ok = true;
+
+	while (fgets(line, sizeof(line), f)) {
+		lineNo++;
+		char* comment = strchr(line, '#');
+		if (comment)
+			*comment = 0;
+
+		char key[64];
+		double v[4];
+		int n = sscanf(line, "%63s %lf %lf %lf %lf", key, &v[0], &v[1], &v[2], &v[3]);
+		if (n <= 0)
+			continue;
+
+		int p = 0;
+		while (p < NUM_SWEEP_PARAMS && strcmp(key, paramNames[p]))
+			p++;
+
+		if (p < NUM_SWEEP_PARAMS && n == 2)
+			sweep.axes[p] = {v[0], v[0], 1};
+		else if (p < NUM_SWEEP_PARAMS && n == 4 && v[2] >= 1)
+			sweep.axes[p] = {v[0], v[1], (int) v[2]};
+		else if (!strcmp(key, "rate") && n == 2)
+			sweep.sampleRate = (int) v[0];
+		else if (!strcmp(key, "seconds") && n == 2)
+			sweep.seconds = v[0];
+		else if (!strcmp(key, "mixer") && n == 4)
+			sweep.mixer[0] = (int) v[0], sweep.mixer[1] = (int) v[1], sweep.mixer[2] = (int) v[2];
+		else if (!strcmp(key, "envelope") && n == 2)
+			sweep.envelope = (int) v[0];
+		else if (!strcmp(key, "vco_mode") && n == 2)
+			sweep.vcoMode = (int) v[0];
+		else if (!strcmp(key, "trigger") && n == 2)
+			sweep.trigger = (v[0] != 0);
+		else {
+			fprintf(stderr, "sn_sweep: %s:%d: cannot parse '%s'\n", path, lineNo, key);
+			ok = false;
+		}
+	}
+
+	fclose(f);
+	return ok;
+}
+
+
+static bool writeWav(const std::string& path, const std::vector<float>& samples, int sampleRate) {
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f)
+		return false;
+
+	uint32_t dataSize = samples.size() * sizeof(float);
+	uint32_t riffSize = 36 + dataSize;
+	uint32_t fmtSize = 16;
+	uint16_t format = 3;  // IEEE float
+	uint16_t channels = 1;
+	uint32_t rate = sampleRate;
+	uint32_t byteRate = sampleRate * sizeof(float);
+	uint16_t blockAlign = sizeof(float);
+	uint16_t bits = 32;
+
+	fwrite("RIFF", 1, 4, f);
+	fwrite(&riffSize, 4, 1, f);
+	fwrite("WAVEfmt ", 1, 8, f);
+	fwrite(&fmtSize, 4, 1, f);
+	fwrite(&format, 2, 1, f);
+	fwrite(&channels, 2, 1, f);
+	fwrite(&rate, 4, 1, f);
+	fwrite(&byteRate, 4, 1, f);
+	fwrite(&blockAlign, 2, 1, f);
+	fwrite(&bits, 2, 1, f);
+	fwrite("data", 1, 4, f);
+	fwrite(&dataSize, 4, 1, f);
+	fwrite(samples.data(), sizeof(float), samples.size(), f);
+
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+
+// Renders one grid point with its own chip instance; the output is scaled like
+// the module's SQR output.
+static void renderPoint(const Sweep& sweep, const double* values, std::vector<float>& out) {
+	sn76477_device sn;
+	sn.set_amp_res(100);
+	sn.set_feedback_res(100);
+	sn.set_m_our_sample_rate(sweep.sampleRate);
+	sn.device_start();
+
+	sn.set_vco_params(2.30, 0, values[VCO_RES]);
+	sn.set_slf_params(CAP_U(.047), values[SLF_RES]);
+	sn.set_noise_params(values[NOISE_CLOCK_RES], values[NOISE_FILTER_RES], CAP_P(470));
+	sn.set_decay_res(values[DECAY_RES]);
+	sn.set_attack_params(0.00000005, values[ATTACK_RES]);
+	sn.set_pitch_voltage(values[DUTY]);
+	sn.set_mixer_params(sweep.mixer[0], sweep.mixer[1], sweep.mixer[2]);
+	sn.set_envelope(sweep.envelope);
+	sn.set_vco_mode(sweep.vcoMode);
+	sn.set_oneshot_params(values[ONE_SHOT_CAP], 5000000);
+	if (sweep.trigger)
+		sn.shot_trigger();
+
+	out.resize((size_t) (sweep.seconds * sweep.sampleRate));
+	for (size_t i = 0; i < out.size(); i++) {
+		Rsamples sam = sn.sound_stream_update(1);
+		out[i] = (5.0 * sam.s1 / 25000) + 1.3;
+	}
+}
+
+
+// Work-stealing pool: every worker owns a deque of point indices, takes from
+// the back of its own and steals from the front of the others when it runs dry.
+struct WorkStealingPool {
+	struct Queue {
+		std::mutex mutex;
+		std::deque<long> tasks;
+	};
+
+	std::vector<Queue> queues;
+
+	WorkStealingPool(int workers, long numTasks) : queues(workers) {
+		for (long t = 0; t < numTasks; t++)
+			queues[t % workers].tasks.push_back(t);
+	}
+
+	bool pop(int worker, long& task) {
+		Queue& own = queues[worker];
+		{
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty()) {
+				task = own.tasks.back();
+				own.tasks.pop_back();
+				return true;
+			}
+		}
+		for (size_t i = 1; i < queues.size(); i++) {
+			Queue& victim = queues[(worker + i) % queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				task = victim.tasks.front();
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <sweep file> <output dir> [-j threads]\n", argv[0]);
+		return 1;
+	}
+
+	int threads = std::thread::hardware_concurrency();
+	if (argc >= 5 && !strcmp(argv[3], "-j"))
+		threads = atoi(argv[4]);
+	if (threads < 1)
+		threads = 1;
+
+	Sweep sweep;
+	if (!parseSweep(argv[1], sweep))
+		return 1;
+
+	std::string outDir = argv[2];
+	long numPoints = sweep.numPoints();
+
+	sn76477_device::select_kernel(sn76477_device::best_kernel());
+	fprintf(stderr, "sn_sweep: %ld points, %d threads, %s kernel\n", numPoints, threads,
+		sn76477_device::kernel_name(sn76477_device::selected_kernel()));
+
+	WorkStealingPool pool(threads, numPoints);
+	std::atomic<long> failed(0);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (int w = 0; w < threads; w++) {
+		workers.push_back(std::thread([&, w]() {
+			std::vector<float> samples;
+			double values[NUM_SWEEP_PARAMS];
+			char name[32];
+			long task;
+
+			while (pool.pop(w, task)) {
+				sweep.pointValues(task, values);
+				renderPoint(sweep, values, samples);
+				snprintf(name, sizeof(name), "/point_%06ld.wav", task);
+				if (!writeWav(outDir + name, samples, sweep.sampleRate))
+					failed++;
+			}
+		}));
+	}
+	for (std::thread& t : workers)
+		t.join();
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	FILE* index = fopen((outDir + "/index.csv").c_str(), "w");
+	if (!index) {
+		fprintf(stderr, "sn_sweep: cannot write %s/index.csv\n", outDir.c_str());
+		return 1;
+	}
+	fprintf(index, "file");
+	for (int p = 0; p < NUM_SWEEP_PARAMS; p++)
+		fprintf(index, ",%s", paramNames[p]);
+	fprintf(index, "\n");
+	for (long t = 0; t < numPoints; t++) {
+		double values[NUM_SWEEP_PARAMS];
+		sweep.pointValues(t, values);
+		fprintf(index, "point_%06ld.wav", t);
+		for (int p = 0; p < NUM_SWEEP_PARAMS; p++)
+			fprintf(index, ",%.9g", values[p]);
+		fprintf(index, "\n");
+	}
+	fclose(index);
+
+	fprintf(stderr, "sn_sweep: rendered %ld points in %.2f s (%.1fx realtime)\n", numPoints, elapsed,
+		elapsed > 0 ? numPoints * sweep.seconds / elapsed : 0.0);
+
+	if (failed) {
+		fprintf(stderr, "sn_sweep: %ld files could not be written\n", (long) failed);
+		return 1;
+	}
+	return 0;
+}
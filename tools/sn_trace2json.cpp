@@ -0,0 +1,119 @@
+// Converts a chip event trace (see src/sntrace.hpp) to Chrome trace JSON.
+//
+//   make sn_trace2json
+//   ./sn_trace2json softSN-trace.bin trace.json
+//
+// Load the result in chrome://tracing or https://ui.perfetto.dev.  Flip-flops
+// and the attack/decay phase show up as counter tracks, one-shots as spans,
+// and pin and mode changes as instant events.  Timestamps are in microseconds
+// of chip time, to sub-step resolution.
+
+#include "sntrace.hpp"
+#include <stdio.h>
+#include <string.h>
+
+
+static const char* pinGroup(uint16_t group) {
+	// The dirty groups of sn76477_device
+	switch (group) {
+		case 1 << 0: return "amp/feedback res";
+		case 1 << 2: return "one-shot pins";
+		case 1 << 3: return "SLF pins";
+		case 1 << 4: return "VCO pins";
+		case 1 << 5: return "noise pins";
+		case 1 << 6: return "attack/decay pins";
+		default: return "pins";
+	}
+}
+
+static const char* modeNames[] = {"mixer", "envelope", "VCO mode"};
+
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <trace.bin> <trace.json>\n", argv[0]);
+		return 1;
+	}
+
+	FILE* in = fopen(argv[1], "rb");
+	if (!in) {
+		fprintf(stderr, "sn_trace2json: cannot open %s\n", argv[1]);
+		return 1;
+	}
+
+	sntrace::FileHeader header;
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, "SNTR", 4) || header.version != sntrace::VERSION) {
+		fprintf(stderr, "sn_trace2json: %s is not a version %u trace\n", argv[1], sntrace::VERSION);
+		fclose(in);
+		return 1;
+	}
+
+	FILE* out = fopen(argv[2], "w");
+	if (!out) {
+		fprintf(stderr, "sn_trace2json: cannot write %s\n", argv[2]);
+		fclose(in);
+		return 1;
+	}
+
+	double usPerSubStep = 1e6 / ((double) header.sampleRate * header.subSteps);
+	bool first = true;
+	bool oneShotOpen = false;
+	uint32_t converted = 0;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	sntrace::Event e;
+	while (converted < header.count && fread(&e, sizeof(e), 1, in) == 1) {
+		double ts = ((double) e.sample * header.subSteps + e.substep) * usPerSubStep;
+		const char* sep = first ? "" : ",\n";
+		first = false;
+		converted++;
+
+		switch (e.type) {
+			case sntrace::VCO_FF:
+			case sntrace::SLF_FF:
+			case sntrace::NOISE_FF:
+			case sntrace::AD_PHASE: {
+				static const char* names[] = {"VCO ff", "SLF ff", "noise ff", "", "", "attack/decay charging"};
+				fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"value\":%g}}",
+					sep, names[e.type], ts, e.value);
+				break;
+			}
+			case sntrace::ONE_SHOT_START:
+				// A retrigger cuts the running span short
+				if (oneShotOpen) {
+					fprintf(out, "%s{\"name\":\"one-shot\",\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":2}", sep, ts);
+					sep = ",\n";
+				}
+				fprintf(out, "%s{\"name\":\"one-shot\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":2,\"args\":{\"cap\":%g}}",
+					sep, ts, e.value);
+				oneShotOpen = true;
+				break;
+			case sntrace::ONE_SHOT_END:
+				// Its start may have dropped out of the ring
+				fprintf(out, "%s{\"name\":\"one-shot%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":2}",
+					sep, oneShotOpen ? "" : " end", oneShotOpen ? "E" : "i", ts);
+				oneShotOpen = false;
+				break;
+			case sntrace::PIN:
+				fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,\"pid\":1,\"tid\":3,\"args\":{\"value\":%g}}",
+					sep, pinGroup(e.arg), ts, e.value);
+				break;
+			case sntrace::MODE:
+				fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,\"pid\":1,\"tid\":3,\"args\":{\"value\":%g}}",
+					sep, (e.arg < 3) ? modeNames[e.arg] : "mode", ts, e.value);
+				break;
+			default:
+				fprintf(out, "%s{\"name\":\"unknown %u\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,\"pid\":1,\"tid\":3}", sep, e.type, ts);
+				break;
+		}
+	}
+
+	fprintf(out, "\n]}\n");
+	fclose(in);
+
+	bool ok = !ferror(out);
+	fclose(out);
+	fprintf(stderr, "sn_trace2json: %u events at %u Hz x %u sub-steps\n", converted, header.sampleRate, header.subSteps);
+	return ok ? 0 : 1;
+}